@@ -0,0 +1,118 @@
+// Compare two result files of `run.js`, typically of two releases, and
+// exit with status 1 if the second regressed by more than the threshold
+// percentage in throughput, 99th percentile latency or bytes allocated per
+// message.
+//
+// Usage: node benchmarks/compare.js BASE.json NEW.json [--threshold=10]
+
+var fs = require('fs');
+
+var files = [];
+var threshold = 10;
+process.argv.slice(2).forEach(function(arg) {
+    var m = /^--threshold=(.*)$/.exec(arg);
+    if (m) {
+        threshold = Number(m[1]);
+    } else {
+        files.push(arg);
+    }
+});
+if (2 !== files.length) {
+    console.error('Usage: node compare.js BASE.json NEW.json ' +
+                  '[--threshold=PERCENT]');
+    process.exit(2);
+}
+
+var base = JSON.parse(fs.readFileSync(files[0]));
+var next = JSON.parse(fs.readFileSync(files[1]));
+
+// The metrics compared, and whether higher values are better.
+var METRICS = [
+    { name: 'msg/s',
+      value: function(r) { return r.messagesPerSecond; },
+      higherIsBetter: true },
+    { name: 'p99 us',
+      value: function(r) { return r.latencyMicroseconds.p99; },
+      higherIsBetter: false },
+    { name: 'B/msg',
+      value: function(r) { return r.heap.bytesPerMessage; },
+      higherIsBetter: false }
+];
+
+function pad(s, n)
+{
+    s = String(s);
+    return n < 0 ? (s + new Array(-n + 1).join(' ')).slice(0, -n)
+                 : (new Array(n + 1).join(' ') + s).slice(-n);
+}
+
+console.log(base.version + ' (' + base.date + ') -> ' +
+            next.version + ' (' + next.date + ')');
+var regressions = 0;
+Object.keys(next.results).forEach(function(name) {
+    var b = base.results[name];
+    var n = next.results[name];
+    if (!b || b.timedOut) {
+        return;
+    }
+    var line = pad(name, -24);
+    if (n.timedOut) {
+        ++regressions;
+        console.log(line + 'timed out');
+        return;
+    }
+    METRICS.forEach(function(metric) {
+        var bv = metric.value(b);
+        var nv = metric.value(n);
+        if (!bv || null === nv) {
+            line += pad('', 30);
+            return;
+        }
+        var change = (nv - bv) / bv * 100;
+        var worse = metric.higherIsBetter ? -change : change;
+        var flag = worse > threshold ? '!' : ' ';
+        if ('!' === flag) {
+            ++regressions;
+        }
+        line += pad(nv, 12) + ' ' + metric.name +
+                pad((change >= 0 ? '+' : '') + change.toFixed(1) + '%', 9) +
+                flag;
+    });
+    console.log(line);
+});
+
+if (regressions) {
+    console.log(regressions + ' regression(s) beyond ' + threshold + '%');
+    process.exit(1);
+}
+
+// Local variables:
+// c-basic-offset: 4
+// tab-width: 4
+// indent-tabs-mode: nil
+// End:
+//
+// vi: set shiftwidth=4 tabstop=4 expandtab:
+// :indentSize=4:tabSize=4:noTabs=true:
+
+// ----------------------------------------------------------------------------
+// Copyright (C) 2015 Bloomberg L.P.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+// ----------------------------- END-OF-FILE ----------------------------------
@@ -0,0 +1,399 @@
+// Benchmarks of the path from the SDK's dispatcher thread to Javascript
+// handlers, run against the fake BLPAPI library (see "Building Against A
+// Fake BLPAPI" in the README).  Each scenario subscribes to a synthetic
+// stream of `MarketDataEvents` and reports:
+//
+//   + the sustained number of messages delivered per second,
+//   + the cost of each message, and of each field by schema type,
+//   + percentiles of the latency from the generation of a tick on the
+//     dispatcher thread to its handler,
+//   + heap usage, bytes allocated per message and collections observed,
+//   + the native `session.stats()` of the measured period.
+//
+// Results are printed, and written as JSON for `compare.js`.
+//
+// Usage: node --expose-gc benchmarks/run.js [--duration=S] [--warmup=S]
+//            [--subscriptions=N] [--only=NAME[,NAME]] [--out=FILE]
+
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+var blpapi = require(path.join(__dirname, '..'));
+
+var options = {
+    duration: 5,            // seconds measured per scenario
+    warmup: 1,              // seconds discarded per scenario
+    subscriptions: 10,
+    only: null,
+    out: 'benchmark-' + require('../package.json').version + '.json'
+};
+process.argv.slice(2).forEach(function(arg) {
+    var m = /^--([a-z]+)=(.*)$/.exec(arg);
+    if (!m || !(m[1] in options)) {
+        console.error('Unknown argument:', arg);
+        process.exit(2);
+    }
+    options[m[1]] = 'only' === m[1] ? m[2].split(',')
+                  : 'out' === m[1] ? m[2]
+                  : Number(m[2]);
+});
+
+// The fields of each schema type, six per type, so that costs per field
+// can be compared.  `FAKE_SEND_TIME` is added to every subscription, and
+// every message also carries two enumerations.
+var SCHEMAS = {
+    envelope: [],
+    float64: ['LAST_PRICE', 'BID', 'ASK', 'PX_OPEN', 'PX_HIGH', 'PX_LOW'],
+    integer: ['BID_SIZE', 'ASK_SIZE', 'SIZE_LAST_TRADE', 'VOLUME',
+              'PX_VOLUME', 'NUM_TRADES_RT'],
+    string: ['NAME', 'TICKER', 'CRNCY', 'ID_ISIN', 'SECURITY_TYP',
+             'SECURITY_DES'],
+    datetime: ['TRADING_DT_REALTIME', 'LAST_UPDATE_DT', 'TIME',
+               'TRADE_UPDATE_STAMP_RT', 'BID_UPDATE_TIME', 'ASK_UPDATE_TIME'],
+    mixed: ['LAST_PRICE', 'BID', 'ASK', 'BID_SIZE', 'ASK_SIZE', 'VOLUME',
+            'TICKER', 'CRNCY', 'TRADING_DT_REALTIME', 'TIME']
+};
+
+// Each scenario runs the stream of one schema, unpaced unless `rate` (in
+// messages per second over all subscriptions) is given, on a session
+// with `sessionOptions`.  `callback` delivers messages to a subscription
+// callback instead of events.
+var SCENARIOS = [
+    { name: 'schema.envelope', schema: 'envelope' },
+    { name: 'schema.float64', schema: 'float64' },
+    { name: 'schema.integer', schema: 'integer' },
+    { name: 'schema.string', schema: 'string' },
+    { name: 'schema.datetime', schema: 'datetime' },
+    { name: 'schema.mixed', schema: 'mixed' },
+    { name: 'dispatch.batch', schema: 'mixed',
+      sessionOptions: { batchEvents: 16 } },
+    { name: 'dispatch.callback', schema: 'mixed', callback: true },
+    { name: 'dispatch.lazyData', schema: 'mixed',
+      sessionOptions: { lazyData: true } },
+    { name: 'dispatch.dataTemplates', schema: 'mixed',
+      sessionOptions: { dataTemplates: true } },
+    { name: 'latency.1k', schema: 'mixed', rate: 1000 },
+    { name: 'latency.10k', schema: 'mixed', rate: 10000 },
+    { name: 'latency.100k', schema: 'mixed', rate: 100000 }
+];
+
+var MAX_SAMPLES = 1000000;
+var STOP_TIMEOUT = 30;              // seconds allowed beyond the measurement
+var HEAP_SAMPLE_INTERVAL = 256;     // messages
+
+function now()
+{
+    var t = process.hrtime();
+    return t[0] * 1e9 + t[1];
+}
+
+function percentile(sorted, p)
+{
+    if (!sorted.length) {
+        return null;
+    }
+    return sorted[Math.min(sorted.length - 1,
+                           Math.floor(sorted.length * p / 100))];
+}
+
+function round(x, digits)
+{
+    var f = Math.pow(10, digits || 0);
+    return null === x ? null : Math.round(x * f) / f;
+}
+
+// Measure the specified `scenario`, and call `done` with its results.
+function measure(scenario, done)
+{
+    var sessionOptions = { serverHost: '127.0.0.1', serverPort: 8194 };
+    for (var k in scenario.sessionOptions || {}) {
+        sessionOptions[k] = scenario.sessionOptions[k];
+    }
+    var session = new blpapi.Session(sessionOptions);
+    var fields = SCHEMAS[scenario.schema].concat(['FAKE_SEND_TIME']);
+
+    var state = 'warmup';
+    var count = 0;
+    var start = 0;
+    var end = 0;
+    var samples = [];
+    var seen = 0;
+    var heap = { start: 0, peak: 0, end: 0, collections: 0, reclaimed: 0 };
+    var lastHeap = 0;
+    var lagMax = 0;
+    var nativeStats = null;
+
+    function onMessage(m) {
+        if ('measure' !== state) {
+            return;
+        }
+        var t = now();
+        ++count;
+
+        // Keep a uniform sample of latencies once there are too many.
+        var latency = t - m.data.FAKE_SEND_TIME;
+        if (samples.length < MAX_SAMPLES) {
+            samples.push(latency);
+        } else {
+            var j = Math.floor(Math.random() * (++seen + MAX_SAMPLES));
+            if (j < MAX_SAMPLES) {
+                samples[j] = latency;
+            }
+        }
+
+        // A drop in heap usage is a collection; count them, and what they
+        // reclaimed, to estimate what the dispatch path allocates.
+        if (0 === count % HEAP_SAMPLE_INTERVAL) {
+            var used = process.memoryUsage().heapUsed;
+            if (used < lastHeap) {
+                ++heap.collections;
+                heap.reclaimed += lastHeap - used;
+            }
+            heap.peak = Math.max(heap.peak, used);
+            lastHeap = used;
+        }
+    }
+
+    // The lateness of a 10ms timer is how long the event loop was blocked.
+    var lagExpected = now() + 10e6;
+    var lagTimer = setInterval(function() {
+        var t = now();
+        if ('measure' === state) {
+            lagMax = Math.max(lagMax, t - lagExpected);
+        }
+        lagExpected = t + 10e6;
+    }, 10);
+
+    function onSessionStarted() {
+        session.openService('//blp/mktdata', 1);
+    }
+
+    function onServiceOpened() {
+        var perSubscription = scenario.rate
+                            ? Math.max(1, Math.round(scenario.rate /
+                                                     options.subscriptions))
+                            : 0;
+        var subscriptions = [];
+        for (var i = 0; i < options.subscriptions; ++i) {
+            var s = { security: 'BENCH' + i + ' US Equity',
+                      correlation: 100 + i,
+                      fields: fields,
+                      options: { fakeTickRate: perSubscription } };
+            if (scenario.callback) {
+                s.callback = onMessage;
+            }
+            subscriptions.push(s);
+        }
+        session.subscribe(subscriptions);
+
+        setTimeout(function() {
+            if (global.gc) {
+                global.gc();
+            }
+            state = 'measure';
+            session.stats(true);
+            heap.start = lastHeap = heap.peak =
+                                               process.memoryUsage().heapUsed;
+            start = now();
+            setTimeout(function() {
+                end = now();
+                nativeStats = session.stats();
+                state = 'stopping';
+                heap.end = process.memoryUsage().heapUsed;
+                session.stop();
+            }, options.duration * 1000);
+        }, options.warmup * 1000);
+    }
+
+    // A scenario that does not terminate in time, such as one whose
+    // session never starts, is reported as timed out rather than blocking
+    // the rest of the run.
+    var finished = false;
+    var timeout = setTimeout(function() {
+        finished = true;
+        clearInterval(lagTimer);
+        session.destroy();
+        done({ timedOut: true });
+    }, (options.warmup + options.duration + STOP_TIMEOUT) * 1000);
+
+    function onSessionTerminated() {
+        if (finished) {
+            return;
+        }
+        finished = true;
+        clearTimeout(timeout);
+        clearInterval(lagTimer);
+        session.destroy();
+        if (global.gc) {
+            global.gc();
+        }
+        var retained = global.gc
+                     ? process.memoryUsage().heapUsed - heap.start
+                     : null;
+
+        samples.sort(function(a, b) { return a - b; });
+        var elapsed = end - start;
+        var allocated = heap.reclaimed + heap.end - heap.start;
+        done({
+            schema: scenario.schema,
+            fieldsPerMessage: fields.length + 2,
+            rate: scenario.rate || null,
+            sessionOptions: scenario.sessionOptions || {},
+            callback: !!scenario.callback,
+            messages: count,
+            seconds: round(elapsed / 1e9, 3),
+            messagesPerSecond: round(count / (elapsed / 1e9)),
+            nsPerMessage: count ? round(elapsed / count) : null,
+            latencyMicroseconds: {
+                samples: samples.length,
+                p50: round(percentile(samples, 50) / 1e3, 1),
+                p99: round(percentile(samples, 99) / 1e3, 1),
+                p999: round(percentile(samples, 99.9) / 1e3, 1),
+                max: round(samples.length
+                           ? samples[samples.length - 1] / 1e3 : null, 1)
+            },
+            eventLoopLagMaxMicroseconds: round(lagMax / 1e3),
+            native: nativeStats,
+            heap: {
+                startBytes: heap.start,
+                peakBytes: heap.peak,
+                retainedBytes: retained,
+                collectionsObserved: heap.collections,
+                bytesPerMessage: count ? round(allocated / count) : null
+            }
+        });
+    }
+
+    var handlers = {
+        SessionStarted: onSessionStarted,
+        ServiceOpened: onServiceOpened,
+        MarketDataEvents: onMessage,
+        SessionTerminated: onSessionTerminated
+    };
+    Object.keys(handlers).forEach(function(type) {
+        session.on(type, handlers[type]);
+    });
+
+    // With `batchEvents`, every message, including session and service
+    // status, is only delivered as part of a batch.
+    session.on('batch', function(messages) {
+        for (var i = 0; i < messages.length; ++i) {
+            var handler = handlers[messages[i].messageType];
+            if (handler) {
+                handler(messages[i]);
+            }
+        }
+    });
+
+    session.start();
+}
+
+// Add the cost of one field of each schema type over that of the
+// envelope, measured by the `schema.*` scenarios.
+function fieldCosts(results)
+{
+    var envelope = results['schema.envelope'];
+    if (!envelope || !envelope.nsPerMessage) {
+        return {};
+    }
+    var costs = {};
+    Object.keys(SCHEMAS).forEach(function(schema) {
+        var r = results['schema.' + schema];
+        if (r && r.nsPerMessage && SCHEMAS[schema].length) {
+            costs[schema] = round((r.nsPerMessage - envelope.nsPerMessage) /
+                                  SCHEMAS[schema].length);
+        }
+    });
+    return costs;
+}
+
+function report(name, r)
+{
+    if (r.timedOut) {
+        console.log((name + new Array(24).join(' ')).slice(0, 24) +
+                    'timed out');
+        return;
+    }
+    var l = r.latencyMicroseconds;
+    console.log(
+        (name + new Array(24).join(' ')).slice(0, 24) +
+        ('         ' + r.messagesPerSecond).slice(-9) + ' msg/s ' +
+        ('      ' + r.nsPerMessage).slice(-7) + ' ns/msg  ' +
+        'p50/p99/p99.9 ' + l.p50 + '/' + l.p99 + '/' + l.p999 + ' us  ' +
+        r.heap.bytesPerMessage + ' B/msg  ' +
+        r.heap.collectionsObserved + ' gc');
+}
+
+var scenarios = SCENARIOS.filter(function(s) {
+    return !options.only || options.only.some(function(o) {
+        return s.name === o || 0 === s.name.indexOf(o + '.');
+    });
+});
+var results = {};
+
+if (!global.gc) {
+    console.log('Run node with --expose-gc to measure retained heap.');
+}
+
+(function next(i) {
+    if (i === scenarios.length) {
+        var output = {
+            version: require('../package.json').version,
+            date: new Date().toISOString(),
+            node: process.versions,
+            platform: process.platform,
+            arch: process.arch,
+            cpu: os.cpus()[0].model,
+            options: options,
+            results: results,
+            nsPerFieldBySchema: fieldCosts(results)
+        };
+        console.log('ns per field by schema:',
+                    JSON.stringify(output.nsPerFieldBySchema));
+        fs.writeFileSync(options.out, JSON.stringify(output, null, 2) + '\n');
+        console.log('Results written to', options.out);
+        if (Object.keys(results).some(function(name) {
+            return results[name].timedOut;
+        })) {
+            process.exit(1);
+        }
+        return;
+    }
+    var scenario = scenarios[i];
+    measure(scenario, function(r) {
+        results[scenario.name] = r;
+        report(scenario.name, r);
+        next(i + 1);
+    });
+})(0);
+
+// Local variables:
+// c-basic-offset: 4
+// tab-width: 4
+// indent-tabs-mode: nil
+// End:
+//
+// vi: set shiftwidth=4 tabstop=4 expandtab:
+// :indentSize=4:tabSize=4:noTabs=true:
+
+// ----------------------------------------------------------------------------
+// Copyright (C) 2015 Bloomberg L.P.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+// ----------------------------- END-OF-FILE ----------------------------------
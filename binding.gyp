@@ -1,4 +1,7 @@
 {
+  'variables': {
+    'blpapi_fake%': 'false'
+  },
   'targets': [
     {
       'target_name': 'blpapijs',
@@ -6,7 +9,18 @@
       'cflags!': [ '-fno-exceptions' ],
       'cflags_cc!': [ '-fno-exceptions' ],
       'conditions': [
-        ['OS=="win"', {
+        ['blpapi_fake=="true"', {
+          'sources': [ 'deps/blpapi/fake/blpapi_fake.cpp' ],
+          'defines': [ 'BLPAPIJS_FAKE' ],
+          'include_dirs': [
+            '<(module_root_dir)/deps/blpapi/include-3.8.8.1'
+          ],
+          'libraries': [ '-lpthread' ],
+          'xcode_settings': {
+            'GCC_ENABLE_CPP_EXCEPTIONS': 'YES'
+          }
+        }],
+        ['OS=="win" and blpapi_fake=="false"', {
           'include_dirs': [
             '<(module_root_dir)/deps/blpapi/include-3.8.8.1'
           ],
@@ -42,7 +56,7 @@
             }]
           ]
         }],
-        ['OS=="linux"', {
+        ['OS=="linux" and blpapi_fake=="false"', {
           'include_dirs': [
             '<(module_root_dir)/deps/blpapi/include-3.8.8.1'
           ],
@@ -59,7 +73,7 @@
             }]
           ]
         }],
-        ['OS=="mac"', {
+        ['OS=="mac" and blpapi_fake=="false"', {
           'include_dirs': [
             '<(module_root_dir)/deps/blpapi/include-3.8.1.1'
           ],
@@ -70,6 +70,13 @@ exports.Session.prototype.authorizeUser =
                            request,
                            cid);
     }
+exports.Session.prototype.authorizeUsers =
+    function(users, options) {
+        return invoke.call(this.session,
+                           this.session.authorizeUsers,
+                           users,
+                           options);
+    }
 exports.Session.prototype.stop =
     function() {
         return invoke.call(this.session, this.session.stop);
@@ -105,7 +112,7 @@ exports.Session.prototype.unsubscribe =
         return invoke.call(this.session, this.session.unsubscribe, sub, label);
     }
 exports.Session.prototype.request =
-    function(uri, name, request, cid, arg5, arg6) {
+    function(uri, name, request, cid, arg5, arg6, options) {
         var identity = arg5;
         var label = arg6;
         if (5 === arguments.length && typeof arg5 === 'string') {
@@ -113,7 +120,38 @@ exports.Session.prototype.request =
             label = arg5;
         }
         return invoke.call(this.session, this.session.request,
-                           uri, name, request, cid, identity, label);
+                           uri, name, request, cid, identity, label, options);
+    }
+exports.Session.prototype.snapshot =
+    function(cid, fields) {
+        return invoke.call(this.session, this.session.snapshot, cid, fields);
+    }
+exports.Session.prototype.stats =
+    function(reset) {
+        return invoke.call(this.session, this.session.stats, reset);
+    }
+exports.Session.prototype.prepareRequest =
+    function(uri, name, shape) {
+        return new RequestTemplate(invoke.call(this.session,
+                                               this.session.prepareRequest,
+                                               uri,
+                                               name,
+                                               shape));
+    }
+
+var RequestTemplate = function(template) {
+    this.template = template;
+};
+RequestTemplate.prototype.send =
+    function(values, cid, arg3, arg4, options) {
+        var identity = arg3;
+        var label = arg4;
+        if (3 === arguments.length && typeof arg3 === 'string') {
+            identity = undefined;
+            label = arg3;
+        }
+        return invoke.call(this.template, this.template.send,
+                           values, cid, identity, label, options);
     }
 
 // Local variables:
@@ -12,23 +12,31 @@
 #include <blpapi_eventdispatcher.h>
 
 #include <blpapi_event.h>
+#include <blpapi_highresolutionclock.h>
 #include <blpapi_message.h>
 #include <blpapi_element.h>
 #include <blpapi_name.h>
 #include <blpapi_request.h>
 #include <blpapi_subscriptionlist.h>
+#include <blpapi_timepoint.h>
 #include <blpapi_defs.h>
 
-#include <deque>
+#include <algorithm>
+#include <limits>
 #include <map>
+#include <set>
 #include <sstream>
+#include <vector>
 
+#include <cerrno>
 #include <cmath>
 #include <ctime>
 #include <cstdlib>
+#include <cstring>
 
 #ifdef _WIN32
 #include <time.h>
+#include <intrin.h>
 #endif
 
 #ifndef uv_mutex_t
@@ -193,8 +201,498 @@ int loadRequest(blpapi::Request *request,
     return loadElement(&elem, val->ToObject(), false, error);
 }
 
+// Load into the specified `host` and `port` the server address in the
+// specified `val`, either a "host:port" string or an object with `host` and
+// `port` properties, and return `true`, or return `false` if `val` is not a
+// valid address.
+bool loadServerAddress(Isolate        *isolate,
+                       Local<Value>    val,
+                       std::string    *host,
+                       unsigned short *port)
+{
+    double number = 0;
+    if (val->IsString()) {
+        String::Utf8Value str(val);
+        const std::string address(*str, str.length());
+        const std::size_t colon = address.rfind(':');
+        if (std::string::npos == colon || 0 == colon)
+            return false;
+        host->assign(address, 0, colon);
+        const char *begin = address.c_str() + colon + 1;
+        char *end = 0;
+        number = std::strtod(begin, &end);
+        if (end == begin || *end)
+            return false;
+    } else if (val->IsObject()) {
+        Local<Object> obj = val->ToObject();
+        Local<Value> h = obj->Get(String::NewFromUtf8(isolate, "host"));
+        Local<Value> p = obj->Get(String::NewFromUtf8(isolate, "port"));
+        if (!h->IsString() || !p->IsNumber())
+            return false;
+        String::Utf8Value str(h);
+        host->assign(*str, str.length());
+        number = p->NumberValue();
+    } else {
+        return false;
+    }
+    if (host->empty() || !(number >= 1 && number <= 65535) ||
+        number != std::floor(number)) {
+        return false;
+    }
+    *port = static_cast<unsigned short>(number);
+    return true;
+}
+
+// Return `true` if the specified `service` is a well formed service name,
+// such as "//blp/mktdata", and `false` otherwise.
+bool isServiceName(const std::string& service)
+{
+    static const char s_valid[] = "-_.0123456789"
+                                  "abcdefghijklmnopqrstuvwxyz"
+                                  "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    if (service.size() < 5 || 0 != service.compare(0, 2, "//"))
+        return false;
+    const std::size_t slash = service.find_first_not_of(s_valid, 2);
+    if (std::string::npos == slash || 2 == slash || '/' != service[slash])
+        return false;
+    return slash + 1 < service.size() &&
+           std::string::npos == service.find_first_not_of(s_valid, slash + 1);
+}
+
+// The queue between the BLPAPI dispatcher thread and the Javascript thread
+// only needs acquire/release ordering on its indices, plus full barriers for
+// the wakeup handshake.
+#ifdef _WIN32
+inline unsigned int atomicLoad(const volatile unsigned int *p)
+{
+    unsigned int v = *p;
+    _ReadWriteBarrier();
+    return v;
+}
+
+inline void atomicStore(volatile unsigned int *p, unsigned int v)
+{
+    _ReadWriteBarrier();
+    *p = v;
+}
+
+inline unsigned int atomicExchange(volatile unsigned int *p, unsigned int v)
+{
+    return static_cast<unsigned int>(
+        _InterlockedExchange(reinterpret_cast<volatile long *>(p),
+                             static_cast<long>(v)));
+}
+#else
+inline unsigned int atomicLoad(const volatile unsigned int *p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+inline void atomicStore(volatile unsigned int *p, unsigned int v)
+{
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+inline unsigned int atomicExchange(volatile unsigned int *p, unsigned int v)
+{
+    return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST);
+}
+#endif
+
 }  // close anonymous namespace
 
+                               // ===============
+                               // class EventRing
+                               // ===============
+
+// A bounded queue of `blpapi::Event`s handed from a single producer, the
+// BLPAPI dispatcher thread, to a single consumer, the Javascript thread.
+// Neither side takes a lock on the fast path: the producer only blocks,
+// on a condition variable, while the ring is full.  The ring also tracks
+// whether the consumer has been signalled, so the producer only needs to
+// wake the event loop when the consumer has gone idle.  Each slot records
+// when its event was pushed, so the consumer can tell how long events
+// waited.
+class EventRing {
+  private:
+    // DATA
+    blpapi::Event         *d_slots;
+    uint64_t              *d_times;     // `uv_hrtime` of each push
+    unsigned int           d_capacity;
+    unsigned int           d_mask;
+
+    // Written by the consumer only.
+    volatile unsigned int  d_head;
+    uint64_t               d_popped;
+    char                   d_pad0[64];
+
+    // Written by the producer only.
+    volatile unsigned int  d_tail;
+    volatile unsigned int  d_blocked;
+    char                   d_pad1[64];
+
+    volatile unsigned int  d_signalled;
+    volatile unsigned int  d_waiting;
+    volatile unsigned int  d_closed;
+    uv_mutex_t             d_mutex;
+    uv_cond_t              d_cond;
+
+    // NOT IMPLEMENTED
+    EventRing(const EventRing&);
+    EventRing& operator=(const EventRing&);
+
+  public:
+    // CREATORS
+
+    // Create a ring holding at least `capacity` events.  The capacity is
+    // rounded up to a power of two.
+    explicit EventRing(unsigned int capacity);
+    ~EventRing();
+
+    // MANIPULATORS
+
+    // Append `event`, blocking while the ring is full.  Return `true` if
+    // the consumer must be woken up.  Called by the producer only.
+    bool push(const blpapi::Event& event);
+
+    // Return the oldest event.  The behavior is undefined if the ring is
+    // empty.  Called by the consumer only.
+    const blpapi::Event& front();
+
+    // Return the event at the specified `index` from the oldest.  The
+    // behavior is undefined unless `index < size()`.  Called by the
+    // consumer only.
+    const blpapi::Event& at(unsigned int index);
+
+    // Return the `uv_hrtime` at which the oldest event was pushed.  The
+    // behavior is undefined if the ring is empty.  Called by the consumer
+    // only.
+    uint64_t frontTime();
+
+    // Release the oldest event.  Called by the consumer only.
+    void pop();
+
+    // Release all events.  Called by the consumer only.
+    void clear();
+
+    // Mark the consumer as no longer draining and return `true` if the
+    // ring is still empty afterwards, in which case the next `push` will
+    // request a wakeup.  Called by the consumer only.
+    bool idle();
+
+    // Release a blocked producer and discard all subsequent pushes.  Must
+    // be called before the `blpapi::Session` is deleted, as its dispatcher
+    // thread may otherwise be blocked waiting for the consumer.
+    void close();
+
+    // ACCESSORS
+    bool empty() const;
+    unsigned int size() const;
+    unsigned int capacity() const;
+
+    // Return the number of events popped since the ring was created.
+    // Called by the consumer only.
+    uint64_t popped() const;
+
+    // Return the number of pushes that had to wait for the ring to have
+    // room.
+    unsigned int blocked() const;
+};
+
+                               // ---------------
+                               // class EventRing
+                               // ---------------
+
+// CREATORS
+EventRing::EventRing(unsigned int capacity)
+: d_capacity(2)
+, d_head(0)
+, d_popped(0)
+, d_tail(0)
+, d_blocked(0)
+, d_signalled(0)
+, d_waiting(0)
+, d_closed(0)
+{
+    while (d_capacity < capacity && d_capacity < 0x80000000U) {
+        d_capacity <<= 1;
+    }
+    d_mask = d_capacity - 1;
+    d_slots = new blpapi::Event[d_capacity];
+    d_times = new uint64_t[d_capacity];
+    uv_mutex_init(&d_mutex);
+    uv_cond_init(&d_cond);
+}
+
+EventRing::~EventRing()
+{
+    delete [] d_slots;
+    delete [] d_times;
+    uv_cond_destroy(&d_cond);
+    uv_mutex_destroy(&d_mutex);
+}
+
+// MANIPULATORS
+bool EventRing::push(const blpapi::Event& event)
+{
+    const unsigned int tail = d_tail;
+    if (tail - atomicLoad(&d_head) == d_capacity) {
+        atomicStore(&d_blocked, d_blocked + 1);
+        uv_mutex_lock(&d_mutex);
+        atomicExchange(&d_waiting, 1);
+        while (!atomicLoad(&d_closed) &&
+               tail - atomicLoad(&d_head) == d_capacity) {
+            uv_cond_wait(&d_cond, &d_mutex);
+        }
+        atomicStore(&d_waiting, 0);
+        uv_mutex_unlock(&d_mutex);
+    }
+    if (atomicLoad(&d_closed)) {
+        return false;
+    }
+
+    d_slots[tail & d_mask] = event;
+    d_times[tail & d_mask] = uv_hrtime();
+    atomicStore(&d_tail, tail + 1);
+
+    return 0 == atomicExchange(&d_signalled, 1);
+}
+
+const blpapi::Event& EventRing::front()
+{
+    return d_slots[d_head & d_mask];
+}
+
+const blpapi::Event& EventRing::at(unsigned int index)
+{
+    return d_slots[(d_head + index) & d_mask];
+}
+
+uint64_t EventRing::frontTime()
+{
+    return d_times[d_head & d_mask];
+}
+
+void EventRing::pop()
+{
+    const unsigned int head = d_head;
+    d_slots[head & d_mask] = blpapi::Event();
+    ++d_popped;
+    atomicExchange(&d_head, head + 1);
+    if (atomicLoad(&d_waiting)) {
+        uv_mutex_lock(&d_mutex);
+        uv_cond_signal(&d_cond);
+        uv_mutex_unlock(&d_mutex);
+    }
+}
+
+void EventRing::clear()
+{
+    while (!empty()) {
+        pop();
+    }
+}
+
+bool EventRing::idle()
+{
+    atomicExchange(&d_signalled, 0);
+    return empty();
+}
+
+void EventRing::close()
+{
+    uv_mutex_lock(&d_mutex);
+    atomicExchange(&d_closed, 1);
+    uv_cond_signal(&d_cond);
+    uv_mutex_unlock(&d_mutex);
+}
+
+// ACCESSORS
+bool EventRing::empty() const
+{
+    return atomicLoad(&d_tail) == d_head;
+}
+
+unsigned int EventRing::size() const
+{
+    return atomicLoad(&d_tail) - atomicLoad(&d_head);
+}
+
+unsigned int EventRing::capacity() const
+{
+    return d_capacity;
+}
+
+uint64_t EventRing::popped() const
+{
+    return d_popped;
+}
+
+unsigned int EventRing::blocked() const
+{
+    return atomicLoad(&d_blocked);
+}
+
+                               // ===============
+                               // class Histogram
+                               // ===============
+
+// A histogram of durations in nanoseconds.  As in HDR histograms, each
+// power of two is split into `SUB_BUCKETS` linear buckets, so that any
+// value up to about 18 minutes is recorded to within 1/32 of itself in
+// constant time and space.  Histograms are only updated and read from the
+// Javascript thread, and take no locks.
+class Histogram {
+  public:
+    enum {
+        SUB_BUCKET_BITS = 5,
+        SUB_BUCKETS = 1 << SUB_BUCKET_BITS,
+        MAX_BITS = 40,                          // larger values are clamped
+        NUM_BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS
+    };
+
+  private:
+    // DATA
+    uint64_t  d_counts[NUM_BUCKETS];
+    uint64_t  d_count;
+    uint64_t  d_min;
+    uint64_t  d_max;
+    double    d_sum;
+
+    // PRIVATE CLASS METHODS
+
+    // Return the index of the bucket of the specified `value`.
+    static unsigned int bucket(uint64_t value);
+
+    // Return the largest value recorded in the bucket at `index`.
+    static uint64_t highestEquivalent(unsigned int index);
+
+  public:
+    // CREATORS
+    Histogram();
+
+    // MANIPULATORS
+    void record(uint64_t value);
+    void reset();
+
+    // ACCESSORS
+    uint64_t count() const;
+    uint64_t min() const;
+    uint64_t max() const;
+    double mean() const;
+
+    // Return the smallest value that the specified `percent` of recorded
+    // values are at most, to the precision of the buckets, or 0 if nothing
+    // was recorded.
+    uint64_t percentile(double percent) const;
+};
+
+                               // ---------------
+                               // class Histogram
+                               // ---------------
+
+// PRIVATE CLASS METHODS
+unsigned int Histogram::bucket(uint64_t value)
+{
+    if (value < SUB_BUCKETS) {
+        return static_cast<unsigned int>(value);
+    }
+    if (value >> MAX_BITS) {
+        value = (static_cast<uint64_t>(1) << MAX_BITS) - 1;
+    }
+
+    unsigned int bit = 0;       // of the highest bit set
+    for (unsigned int shift = 32; shift; shift >>= 1) {
+        if (value >> (bit + shift)) {
+            bit += shift;
+        }
+    }
+
+    // The highest `SUB_BUCKET_BITS + 1` bits select the bucket.
+    const unsigned int shift = bit - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS +
+           static_cast<unsigned int>(value >> shift) - SUB_BUCKETS;
+}
+
+uint64_t Histogram::highestEquivalent(unsigned int index)
+{
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    const unsigned int shift = index / SUB_BUCKETS - 1;
+    const uint64_t first = index % SUB_BUCKETS + SUB_BUCKETS;
+    return ((first + 1) << shift) - 1;
+}
+
+// CREATORS
+Histogram::Histogram()
+{
+    reset();
+}
+
+// MANIPULATORS
+void Histogram::record(uint64_t value)
+{
+    ++d_counts[bucket(value)];
+    if (0 == d_count++ || value < d_min) {
+        d_min = value;
+    }
+    if (value > d_max) {
+        d_max = value;
+    }
+    d_sum += static_cast<double>(value);
+}
+
+void Histogram::reset()
+{
+    std::fill(d_counts, d_counts + NUM_BUCKETS, 0);
+    d_count = 0;
+    d_min = 0;
+    d_max = 0;
+    d_sum = 0;
+}
+
+// ACCESSORS
+uint64_t Histogram::count() const
+{
+    return d_count;
+}
+
+uint64_t Histogram::min() const
+{
+    return d_min;
+}
+
+uint64_t Histogram::max() const
+{
+    return d_max;
+}
+
+double Histogram::mean() const
+{
+    return d_count ? d_sum / static_cast<double>(d_count) : 0;
+}
+
+uint64_t Histogram::percentile(double percent) const
+{
+    if (!d_count) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(
+                     std::ceil(percent / 100 * static_cast<double>(d_count)));
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < NUM_BUCKETS; ++i) {
+        seen += d_counts[i];
+        if (seen >= rank) {
+            return std::min(highestEquivalent(i), d_max);
+        }
+    }
+    return d_max;
+}
+
                                // ==============
                                // class Identity
                                // ==============
@@ -262,12 +760,25 @@ const blpapi::Identity* Identity::getIdentity() const
     return &d_identity;
 }
 
+class MessageData;
+class RequestTemplate;
+
 class Session : public ObjectWrap,
                 public blpapi::EventHandler {
+    friend class MessageData;
+    friend class RequestTemplate;
 public:
+    // What to do with subscription data when Javascript falls behind and
+    // the native queue passes its high water mark.
+    enum SlowConsumerPolicy {
+        BLOCK,          // keep everything; the dispatcher thread blocks
+        DROP_OLDEST,    // discard the oldest queued subscription data
+        CONFLATE        // deliver only the latest queued update per topic
+    };
+
     Session(const FunctionCallbackInfo<Value>& args,
-            const std::string& serverHost, int serverPort,
-            const std::string& authenticationOptions);
+            const blpapi::SessionOptions& options,
+            unsigned int queueSize);
     ~Session();
 
     static void Initialize(Handle<Object> target);
@@ -276,6 +787,7 @@ public:
     static void Start(const FunctionCallbackInfo<Value>& args);
     static void Authorize(const FunctionCallbackInfo<Value>& args);
     static void AuthorizeUser(const FunctionCallbackInfo<Value>& args);
+    static void AuthorizeUsers(const FunctionCallbackInfo<Value>& args);
     static void Stop(const FunctionCallbackInfo<Value>& args);
     static void Destroy(const FunctionCallbackInfo<Value>& args);
     static void OpenService(const FunctionCallbackInfo<Value>& args);
@@ -283,33 +795,292 @@ public:
     static void Resubscribe(const FunctionCallbackInfo<Value>& args);
     static void Unsubscribe(const FunctionCallbackInfo<Value>& args);
     static void Request(const FunctionCallbackInfo<Value>& args);
+    static void PrepareRequest(const FunctionCallbackInfo<Value>& args);
+    static void Snapshot(const FunctionCallbackInfo<Value>& args);
+    static void Stats(const FunctionCallbackInfo<Value>& args);
 
 private:
     Session();
     Session(const Session&);
     Session& operator=(const Session&);
 
+    // A request whose securities are sent in chunks of separate requests,
+    // with at most `d_max_pending` of them outstanding at a time.
+    struct ChunkedRequest {
+        blpapi::CorrelationId           d_cid;          // the user's
+        blpapi::Identity                d_identity;
+        std::string                     d_label;
+        std::vector<blpapi::Request *>  d_requests;     // 0 once sent
+        std::vector<uint64_t>           d_sent;         // send times (ns)
+        std::size_t                     d_next;         // next to send
+        unsigned int                    d_max_pending;
+        unsigned int                    d_pending;
+        unsigned int                    d_completed;
+        unsigned int                    d_failed;
+        unsigned int                    d_securities;
+        double                          d_messages;
+        uint64_t                        d_start;        // ns
+        uint64_t                        d_min_latency;  // of chunks, in ns
+        uint64_t                        d_max_latency;
+        uint64_t                        d_total_latency;
+        unsigned int                    d_timed;        // chunks timed
+        std::string                     d_error;        // last send error
+
+        ChunkedRequest(const blpapi::CorrelationId& cid,
+                       unsigned int                 maxPending,
+                       unsigned int                 securities)
+        : d_cid(cid), d_next(0), d_max_pending(maxPending), d_pending(0)
+        , d_completed(0), d_failed(0), d_securities(securities)
+        , d_messages(0), d_start(uv_hrtime()), d_min_latency(0)
+        , d_max_latency(0), d_total_latency(0), d_timed(0)
+        {
+        }
+
+        ~ChunkedRequest()
+        {
+            for (std::size_t i = 0; i < d_requests.size(); ++i) {
+                delete d_requests[i];
+            }
+        }
+    };
+    typedef std::map<blpapi::CorrelationId,
+                     std::pair<ChunkedRequest *, std::size_t> > ChunkMap;
+
+    // The chunks completed by the event being dispatched, with the
+    // correlation id and event type their messages are reported with.
+    typedef std::map<blpapi::CorrelationId,
+                     std::pair<blpapi::CorrelationId,
+                               blpapi::Event::EventType> > ChunkTailMap;
+
+    // An `authorize` waiting for its token, and then for the response to
+    // its authorization request.
+    struct PendingAuthorization {
+        std::string                    d_uri;
+        blpapi::CorrelationId          d_cid;       // the user's
+        Persistent<Promise::Resolver>  d_resolver;
+
+        ~PendingAuthorization()
+        {
+            d_resolver.Reset();
+        }
+    };
+    typedef std::map<blpapi::CorrelationId, PendingAuthorization *>
+                                                            AuthorizationMap;
+
+    // An `authorizeUsers` call, whose authorization requests are sent with
+    // at most `d_max_pending` of them outstanding at a time.
+    struct BulkAuthorization {
+        Persistent<Promise::Resolver>   d_resolver;
+        Persistent<Array>               d_results;
+        std::vector<std::string>        d_keys;
+        std::vector<blpapi::Request *>  d_requests;    // 0 if not needed
+        std::vector<blpapi::Identity>   d_identities;
+        std::vector<std::size_t>        d_queue;       // indices to send
+        std::size_t                     d_next;        // in `d_queue`
+        unsigned int                    d_max_pending;
+        unsigned int                    d_pending;
+        std::size_t                     d_remaining;
+        double                          d_ttl;         // ms, 0 for none
+
+        BulkAuthorization(std::size_t  numUsers,
+                          unsigned int maxPending,
+                          double       ttl)
+        : d_keys(numUsers), d_requests(numUsers), d_identities(numUsers)
+        , d_next(0), d_max_pending(maxPending), d_pending(0)
+        , d_remaining(numUsers), d_ttl(ttl)
+        {
+        }
+
+        ~BulkAuthorization()
+        {
+            for (std::size_t i = 0; i < d_requests.size(); ++i) {
+                delete d_requests[i];
+            }
+            d_resolver.Reset();
+            d_results.Reset();
+        }
+    };
+    typedef std::map<blpapi::CorrelationId,
+                     std::pair<BulkAuthorization *, std::size_t> >
+                                                        UserAuthorizationMap;
+
+    // An authorized identity, with the correlation id of the request that
+    // authorized it, on which entitlement changes are reported.
+    struct CachedIdentity {
+        blpapi::Identity       d_identity;
+        blpapi::CorrelationId  d_cid;
+        uint64_t               d_expiry;   // `uv_hrtime`, 0 for never
+    };
+
+    // The class id of the correlation ids standing for Javascript objects,
+    // whose integer value is the key of the object in the table of object
+    // correlations.  Integer correlation ids given by users have class 0.
+    enum { OBJECT_CORRELATION_CLASS_ID = 1 };
+
+    // A Javascript object used as a correlation id.  It is kept while a
+    // request or subscription uses it, and until the events queued when it
+    // was last released have been dispatched.  Keys are never reused, so
+    // messages that refer to a forgotten object, for example from the SDK's
+    // own queue, resolve to no object rather than to another one.
+    struct ObjectCorrelation {
+        Persistent<Object>  d_object;
+        int                 d_hash;     // `GetIdentityHash` of `d_object`
+        long long           d_key;
+        unsigned int        d_uses;
+        uint64_t            d_released; // events queued when last released
+
+        ~ObjectCorrelation()
+        {
+            d_object.Reset();
+        }
+    };
+    typedef std::multimap<int, ObjectCorrelation *> ObjectCorrelationMap;
+    typedef std::map<long long, ObjectCorrelation *> ObjectCorrelationKeyMap;
+
+    // The last value of a field of a subscription.
+    struct FieldValue {
+        enum Type { NONE, NULL_VALUE, BOOLEAN, NUMBER, STRING, DATE };
+
+        unsigned char  d_type;
+        double         d_number;   // also booleans and dates
+        std::string    d_string;
+
+        FieldValue()
+        : d_type(NONE), d_number(0)
+        {
+        }
+    };
+    typedef std::map<blpapi::CorrelationId, std::vector<FieldValue> >
+                                                              LastValueMap;
+
+    // The time spent on the messages of one type.
+    struct MessageStats {
+        blpapi::Name  d_name;
+        Histogram     d_conversion;  // building the message object
+        Histogram     d_emit;        // in its handlers
+    };
+
     static void subscribe(const FunctionCallbackInfo<Value>& args,
                           int action);
-    static void formFields(std::string* str, Handle<Object> array);
+    static void formFields(std::string* str,
+                           Handle<Object> array,
+                           std::vector<blpapi::Name> *names = 0);
     static void formOptions(std::string* str, Handle<Value> array);
-    static Handle<Value> elementToValue(Isolate *, const blpapi::Element& e);
-    static Handle<Value> elementValueToValue(Isolate *,
-                                             const blpapi::Element& e,
-                                             int idx = 0);
+    Handle<Value> elementToValue(Isolate *, const blpapi::Element& e);
+    Handle<Value> elementValueToValue(Isolate *,
+                                      const blpapi::Element& e,
+                                      int idx = 0);
+    Handle<Value> dataToValue(Isolate *isolate,
+                              const blpapi::Name& messageType,
+                              const blpapi::Element& e);
+    Handle<Value> columnarElementToValue(Isolate *isolate,
+                                         const blpapi::Element& e);
+    Handle<Value> columnsToValue(Isolate *isolate,
+                                 const blpapi::Element& rows);
+    Handle<Value> projectElement(Isolate *isolate,
+                                 const blpapi::Element& e,
+                                 const std::vector<blpapi::Name>& names);
+    void cacheLastValues(const blpapi::Message& msg);
+    Local<Value> fieldValueToValue(Isolate *isolate, const FieldValue& v);
+    Handle<Value> mergeElements(Isolate *isolate,
+                                const blpapi::Message& msg,
+                                const std::vector<blpapi::Message>& older,
+                                const std::vector<blpapi::Name> *names);
+
+    Local<String> internName(Isolate *isolate, const blpapi::Name& name);
+    Local<String> internTopic(Isolate *isolate, const char *topic);
+    Local<String> internEventType(Isolate *isolate,
+                                  blpapi::Event::EventType et);
+    void clearInterned();
 
     const blpapi::Identity* getIdentity(const FunctionCallbackInfo<Value>& args,
                                         int index);
 
     bool processEvent(const blpapi::Event& ev, blpapi::Session* session);
     static void processEvents(uv_async_t *async);
+    static void closeAsync(uv_handle_t *handle);
     void processMessage(Isolate *isolate,
                         blpapi::Event::EventType et,
                         const blpapi::Message& msg);
+    void checkSlowConsumer(Isolate *isolate);
+    bool dropEvent(const blpapi::Event& ev);
+    void scanUpdates();
+    bool conflateMessage(blpapi::Event::EventType et,
+                         const blpapi::Message& msg);
+    void emitQueueStatus(Isolate *isolate, const char *messageType);
+    void setMessageTimes(Isolate *isolate,
+                         Handle<Object> message,
+                         const blpapi::Message& msg,
+                         uint64_t dispatched);
+    void recordMessage(const blpapi::Name& messageType,
+                       uint64_t conversion,
+                       uint64_t emit);
+    static Local<Object> histogramToValue(Isolate *isolate,
+                                          const Histogram& histogram);
+    void clearStats();
+    static Local<Object> newMessage(Isolate *isolate,
+                                    Handle<Value> eventType,
+                                    Handle<Value> messageType,
+                                    Handle<Value> topicName,
+                                    Handle<Value> correlations,
+                                    Handle<Value> data);
+
+    void deliver(Isolate *isolate,
+                 Handle<Value> messageType,
+                 Handle<Object> message);
+    void clearCallbacks();
+    void flushBatch(Isolate *isolate);
+    void release();
+
+    static bool isCorrelation(Handle<Value> value);
+    static bool toInteger(Handle<Value> value, long long *result);
+    blpapi::CorrelationId toCorrelationId(Isolate *isolate,
+                                          Handle<Value> value,
+                                          bool create = true);
+    Local<Value> correlationValue(Isolate *isolate,
+                                  const blpapi::CorrelationId& cid);
+    void retainCorrelation(const blpapi::CorrelationId& cid);
+    void releaseCorrelation(const blpapi::CorrelationId& cid);
+    void sweepCorrelations(bool force);
+    void clearCorrelations();
+    void forgetSubscription(const blpapi::CorrelationId& cid);
+    ObjectCorrelation *findObjectCorrelation(
+                                  const blpapi::CorrelationId& cid) const;
+
+    void sendRequest(const FunctionCallbackInfo<Value>& args,
+                     const blpapi::Request& request,
+                     const blpapi::CorrelationId& cid,
+                     int index);
+    void sendChunks(ChunkedRequest *cr);
+    blpapi::Event::EventType completeChunk(Isolate *isolate,
+                                           ChunkMap::iterator chunk,
+                                           blpapi::Event::EventType et,
+                                           Local<Object> *stats);
+    void finishChunks();
+    void clearChunks();
+    void requestAuthorization(Isolate *isolate,
+                              PendingAuthorization *auth,
+                              const blpapi::Message& msg);
+    void settleAuthorization(Isolate *isolate,
+                             PendingAuthorization *auth,
+                             bool success,
+                             Handle<Value> value);
+    void clearAuthorizations(bool reject);
+    void sendUserAuthorizations(Isolate *isolate, BulkAuthorization *bulk);
+    void setUserAuthorization(Isolate *isolate,
+                              BulkAuthorization *bulk,
+                              std::size_t index,
+                              Handle<Value> identity,
+                              bool cached,
+                              Handle<Value> error);
+    void completeUserAuthorization(Isolate *isolate,
+                                   UserAuthorizationMap::iterator it,
+                                   const blpapi::Message& msg,
+                                   bool success);
+    void clearUserAuthorizations(bool reject);
 
     void emit(Isolate *isolate, int argc, Handle<Value> argv[]);
 
-    static uv_async_t s_async;
     static Persistent<String> s_emit;
     static Persistent<String> s_event_type;
     static Persistent<String> s_message_type;
@@ -319,99 +1090,846 @@ private:
     static Persistent<String> s_class_id;
     static Persistent<String> s_data;
     static Persistent<String> s_identity;
+    static Persistent<String> s_queue_depth;
+    static Persistent<String> s_queue_size;
+    static Persistent<String> s_dropped;
+    static Persistent<String> s_conflated;
+    static Persistent<String> s_batch;
+    static Persistent<String> s_codes;
+    static Persistent<String> s_values;
+    static Persistent<String> s_stats;
+    static Persistent<String> s_key;
+    static Persistent<String> s_error;
+    static Persistent<String> s_cached;
+    static Persistent<String> s_time_received;
+    static Persistent<String> s_time_enqueued;
+    static Persistent<String> s_time_dispatched;
+    static Eternal<ObjectTemplate> s_message_template;
+
+    // The top-level element names of the first message of a type, and the
+    // template its `data` objects are created from.
+    struct DataTemplate {
+        std::vector<blpapi::Name> d_names;
+        Persistent<ObjectTemplate> d_template;
+    };
 
     Isolate *d_isolate;
     blpapi::SessionOptions d_options;
     blpapi::Session *d_session;
     blpapi::Identity d_identity;
     Persistent<Object> d_session_ref;
-    std::deque<blpapi::Event> d_que;
-    std::map<int, blpapi::Identity> d_identities;
-    uv_mutex_t d_que_mutex;
+    uv_async_t *d_async;
+    EventRing d_que;
+    blpapi::MessageIterator *d_msg_iter;
+    unsigned int d_max_dispatch_messages;
+    uint64_t d_max_dispatch_time;
+    SlowConsumerPolicy d_slow_consumer_policy;
+    unsigned int d_hi_water_mark;
+    unsigned int d_lo_water_mark;
+    bool d_slow_consumer;
+    std::map<blpapi::CorrelationId, unsigned int> d_pending_updates;
+    unsigned int d_update_window;
+    double d_dropped;
+    double d_conflated;
+    Persistent<Array> d_batch;
+    uint32_t d_batch_length;
+    unsigned int d_batch_events;
+    unsigned int d_max_batch_events;
+    Persistent<Function> d_emit;
+    std::map<blpapi_Name_t *, Persistent<String> *> d_names;
+    std::map<std::string, Persistent<String> *> d_topics;
+    Persistent<String> d_event_types[BLPAPI_EVENTTYPE_REQUEST + 1];
+    bool d_lazy_data;
+    MessageData *d_live_data;
+    bool d_project_fields;
+    std::map<blpapi::CorrelationId, std::vector<blpapi::Name> > d_projections;
+    std::set<blpapi::CorrelationId> d_columnar;
+    ChunkMap d_chunks;
+    ChunkTailMap d_chunk_tails;
+    AuthorizationMap d_authorizations;
+    UserAuthorizationMap d_user_authorizations;
+    std::map<std::string, CachedIdentity> d_identity_cache;
+    std::map<blpapi::CorrelationId, std::string> d_cached_cids;
+    bool d_use_data_templates;
+    std::map<blpapi_Name_t *, DataTemplate *> d_data_templates;
+    bool d_merge_updates;
+    bool d_cache_last_values;
+    std::map<blpapi_Name_t *, std::size_t> d_field_indices;
+    std::vector<blpapi::Name> d_field_names;
+    LastValueMap d_last_values;
+    std::map<blpapi::CorrelationId, std::vector<blpapi::Message> >
+                                                          d_merged_updates;
+    std::map<blpapi::CorrelationId, blpapi::Identity> d_identities;
+    std::map<blpapi::CorrelationId, Persistent<Function> *> d_callbacks;
+    ObjectCorrelationMap d_object_correlations;
+    ObjectCorrelationKeyMap d_correlation_objects;
+    std::set<blpapi::CorrelationId> d_subscribed_objects;
+    long long d_next_correlation_key;
+    unsigned int d_unused_correlations;     // since the last sweep
+    unsigned int d_deferred_correlations;   // left by the last sweep
+    Histogram d_queue_times;
+    Histogram d_receive_times;
+    bool d_record_times;
+    Histogram d_batch_emit_times;
+    std::map<blpapi_Name_t *, MessageStats *> d_message_stats;
+    MessageStats *d_last_message_stats;
+    unsigned int d_max_depth;
+    uint64_t d_stats_start;
     bool d_started;
     bool d_stopped;
     bool d_dispatching;
     bool d_destroy;
 };
 
-uv_async_t Session::s_async;
-Persistent<String> Session::s_emit;
-Persistent<String> Session::s_event_type;
-Persistent<String> Session::s_message_type;
-Persistent<String> Session::s_topic_name;
-Persistent<String> Session::s_correlations;
-Persistent<String> Session::s_value;
-Persistent<String> Session::s_class_id;
-Persistent<String> Session::s_data;
-Persistent<String> Session::s_identity;
+                              // =================
+                              // class MessageData
+                              // =================
+
+// The `data` object of a message delivered in lazy mode.  Instead of
+// converting the whole message when it is dispatched, the object keeps a
+// reference to the `blpapi::Message` and converts each top-level element
+// the first time it is read, caching the result.  Messages can not outlive
+// their `blpapi::Session`, so the session detaches all live objects before
+// it is destroyed; only already converted elements remain readable.
+class MessageData : public ObjectWrap {
+  private:
+    // CLASS DATA
+    static Eternal<ObjectTemplate> s_objectTemplate;
 
-Session::Session(
-                 const FunctionCallbackInfo<Value>& args,
-                 const std::string& serverHost, int serverPort,
-                 const std::string& authenticationOptions)
-    : d_isolate(args.GetIsolate())
-    , d_started(false)
-    , d_stopped(false)
-    , d_dispatching(false)
-    , d_destroy(false)
-{
-    d_options.setServerHost(serverHost.c_str());
-    d_options.setServerPort(serverPort);
-    if (authenticationOptions.length())
-        d_options.setAuthenticationOptions(authenticationOptions.c_str());
+    // DATA
+    blpapi::Message  d_message;
+    Session         *d_session;  // owning session, or 0 once detached
+    MessageData     *d_prev;     // list of the session's live objects
+    MessageData     *d_next;
 
-    BLPAPI_EXCEPTION_TRY
-    d_session = new blpapi::Session(d_options, this);
-    BLPAPI_EXCEPTION_CATCH
+    // PRIVATE CREATORS
+    MessageData(Session *session, const blpapi::Message& message);
 
-    uv_mutex_init(&d_que_mutex);
+    // PRIVATE CLASS METHODS
+    static Local<Object> cache(Handle<Object> object);
 
-    uv_ref(reinterpret_cast<uv_handle_t *>(&s_async));
-}
+    static void getNamed(Local<String> property,
+                         const PropertyCallbackInfo<Value>& info);
+    static void queryNamed(Local<String> property,
+                           const PropertyCallbackInfo<Integer>& info);
+    static void enumerateNamed(const PropertyCallbackInfo<Array>& info);
 
-Session::~Session()
-{
-    // Ref on the event loop is released in Destroy
+  public:
+    // CLASS METHODS
+    static void Initialize(Handle<Object> target);
 
-    uv_mutex_destroy(&d_que_mutex);
+    static Local<Object> New(Isolate               *isolate,
+                             Session               *session,
+                             const blpapi::Message& message);
 
-    // If the `Session` object in Javascript is collected without `stop()`
-    // or `destroy()` being called, the underlying `blpapi::Session` still
-    // needs to be cleaned up.
-    if (d_session) {
-        delete d_session;
-        d_session = NULL;
-    }
-}
+    // Set the property `key` of the specified lazy `object` to `value`,
+    // as if it were an element of the message.
+    static void setCached(Handle<Object> object,
+                          Handle<String> key,
+                          Handle<Value>  value);
 
-void
-Session::Initialize(Handle<Object> target)
-{
-    Isolate *isolate = Isolate::GetCurrent();
-    HandleScope scope(isolate);
-    Local<FunctionTemplate> t = FunctionTemplate::New(isolate, Session::New);
+    // CREATORS
+    ~MessageData();
 
-    t->InstanceTemplate()->SetInternalFieldCount(1);
+    // MANIPULATORS
 
-    NODE_SET_PROTOTYPE_METHOD(t, "start", Start);
-    NODE_SET_PROTOTYPE_METHOD(t, "authorize", Authorize);
-    NODE_SET_PROTOTYPE_METHOD(t, "authorizeUser", AuthorizeUser);
-    NODE_SET_PROTOTYPE_METHOD(t, "stop", Stop);
-    NODE_SET_PROTOTYPE_METHOD(t, "destroy", Destroy);
-    NODE_SET_PROTOTYPE_METHOD(t, "openService", OpenService);
-    NODE_SET_PROTOTYPE_METHOD(t, "subscribe", Subscribe);
-    NODE_SET_PROTOTYPE_METHOD(t, "resubscribe", Resubscribe);
-    NODE_SET_PROTOTYPE_METHOD(t, "unsubscribe", Unsubscribe);
-    NODE_SET_PROTOTYPE_METHOD(t, "request", Request);
+    // Release the message and unlink from the owning session.
+    void detach();
+};
 
-    target->Set(String::NewFromUtf8(isolate, "Session",
-                                    v8::String::kInternalizedString),
-                t->GetFunction());
+                              // -----------------
+                              // class MessageData
+                              // -----------------
 
-    uv_async_init(uv_default_loop(), &s_async, Session::processEvents);
+// CLASS DATA
+Eternal<ObjectTemplate> MessageData::s_objectTemplate;
 
-#define NODE_PSYMBOL(x) \
-    String::NewFromUtf8(isolate, x, String::kInternalizedString)
+// PRIVATE CREATORS
+MessageData::MessageData(Session *session, const blpapi::Message& message)
+: d_message(message)
+, d_session(session)
+, d_prev(NULL)
+, d_next(session->d_live_data)
+{
+    if (d_next) {
+        d_next->d_prev = this;
+    }
+    session->d_live_data = this;
+}
+
+// PRIVATE CLASS METHODS
+Local<Object> MessageData::cache(Handle<Object> object)
+{
+    return object->GetInternalField(1)->ToObject();
+}
+
+void MessageData::getNamed(Local<String> property,
+                           const PropertyCallbackInfo<Value>& info)
+{
+    Local<Object> values = cache(info.Holder());
+    if (values->HasOwnProperty(property)) {
+        info.GetReturnValue().Set(values->Get(property));
+        return;
+    }
+
+    MessageData *md = ObjectWrap::Unwrap<MessageData>(info.Holder());
+    if (!md->d_session) {
+        return;
+    }
+
+    // Names the message does not contain are not intercepted, so that
+    // lookups fall through to the prototype.
+    String::Utf8Value name(property);
+    blpapi::Element e;
+    if (0 != md->d_message.asElement().getElement(&e, *name)) {
+        return;
+    }
+
+    Handle<Value> value = md->d_session->elementToValue(info.GetIsolate(), e);
+    values->Set(property, value);
+    info.GetReturnValue().Set(value);
+}
+
+void MessageData::queryNamed(Local<String> property,
+                             const PropertyCallbackInfo<Integer>& info)
+{
+    MessageData *md = ObjectWrap::Unwrap<MessageData>(info.Holder());
+    String::Utf8Value name(property);
+    if (cache(info.Holder())->HasOwnProperty(property) ||
+        (md->d_session && md->d_message.hasElement(*name))) {
+        info.GetReturnValue().Set(Integer::New(info.GetIsolate(),
+                                               ReadOnly | DontDelete));
+    }
+}
+
+void MessageData::enumerateNamed(const PropertyCallbackInfo<Array>& info)
+{
+    Isolate *isolate = info.GetIsolate();
+    MessageData *md = ObjectWrap::Unwrap<MessageData>(info.Holder());
+    Local<Object> values = cache(info.Holder());
+    Local<Array> names = Array::New(isolate);
+    uint32_t length = 0;
+
+    // Elements of the message, in message order, followed by properties
+    // added with `setCached` or converted before the object was detached.
+    if (md->d_session) {
+        blpapi::Element root = md->d_message.asElement();
+        const std::size_t numElements = root.numElements();
+        for (std::size_t i = 0; i < numElements; ++i) {
+            names->Set(length++,
+                       md->d_session->internName(isolate,
+                                                 root.getElement(i).name()));
+        }
+    }
+    Local<Array> cached = values->GetOwnPropertyNames();
+    for (uint32_t i = 0; i < cached->Length(); ++i) {
+        Local<Value> key = cached->Get(i);
+        String::Utf8Value name(key);
+        if (!md->d_session || !md->d_message.hasElement(*name)) {
+            names->Set(length++, key);
+        }
+    }
+
+    info.GetReturnValue().Set(names);
+}
+
+// CLASS METHODS
+void MessageData::Initialize(Handle<Object> target)
+{
+    Local<ObjectTemplate> objectTemplate;
+    Isolate *isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+    objectTemplate = ObjectTemplate::New(isolate);
+    objectTemplate->SetInternalFieldCount(2);
+    objectTemplate->SetNamedPropertyHandler(getNamed,
+                                            0,
+                                            queryNamed,
+                                            0,
+                                            enumerateNamed);
+    s_objectTemplate.Set(isolate, objectTemplate);
+}
+
+Local<Object> MessageData::New(Isolate               *isolate,
+                               Session               *session,
+                               const blpapi::Message& message)
+{
+    Local<Object> object;
+    object = s_objectTemplate.Get(isolate)->NewInstance();
+    object->SetInternalField(1, Object::New(isolate));
+    MessageData *md = new MessageData(session, message);
+    md->Wrap(object);
+    return object;
+}
+
+void MessageData::setCached(Handle<Object> object,
+                            Handle<String> key,
+                            Handle<Value>  value)
+{
+    cache(object)->Set(key, value);
+}
+
+// CREATORS
+MessageData::~MessageData()
+{
+    detach();
+}
+
+// MANIPULATORS
+void MessageData::detach()
+{
+    if (!d_session) {
+        return;
+    }
+
+    if (d_prev) {
+        d_prev->d_next = d_next;
+    } else {
+        d_session->d_live_data = d_next;
+    }
+    if (d_next) {
+        d_next->d_prev = d_prev;
+    }
+    d_prev = d_next = NULL;
+    d_session = NULL;
+    d_message = blpapi::Message(NULL);
+}
+
+                            // =====================
+                            // class RequestTemplate
+                            // =====================
+
+// A request whose shape was resolved against the service schema once, by
+// `Session::prepareRequest`.  The shape is an object like the parameters of
+// `Session::request`, except that nested objects are flattened into element
+// paths, and `null` leaves are slots whose values are supplied to each
+// `send`, keyed by their dot-separated path.  Sending walks the pre-resolved
+// element names, sets the constants already converted to native values, and
+// only converts the slot values.
+class RequestTemplate : public ObjectWrap {
+  private:
+    // A constant leaf of the shape, converted from JavaScript once.
+    struct Constant {
+        enum Type {
+            e_STRING,
+            e_BOOL,
+            e_NUMBER,
+            e_DATETIME,
+            e_ARRAY,
+            e_OBJECT
+        };
+
+        Type                     d_type;
+        std::string              d_string;    // string value
+        bool                     d_bool;      // boolean value
+        double                   d_number;    // number value
+        blpapi::Datetime         d_datetime;  // date value
+        std::vector<Constant>    d_items;     // array items or members
+        std::vector<std::string> d_names;     // member names of an object
+    };
+
+    // One leaf of the shape.
+    struct Binding {
+        std::vector<blpapi::Name> d_path;      // element names from the root
+        Persistent<String>        d_key;       // slot key, or empty
+        Constant                  d_constant;  // value if `d_key` is empty
+    };
+
+    // CLASS DATA
+    static Eternal<ObjectTemplate> s_objectTemplate;
+
+    // DATA
+    Persistent<Object>      d_session_ref;
+    blpapi::Service         d_service;
+    std::string             d_operation;
+    std::vector<Binding *>  d_bindings;
+
+    // PRIVATE CREATORS
+    RequestTemplate(const blpapi::Service& service, const char *operation);
+
+    // PRIVATE MANIPULATORS
+    int compile(Isolate                    *isolate,
+                const blpapi::Element&      elem,
+                Local<Object>               shape,
+                std::vector<blpapi::Name>  *path,
+                const std::string&          prefix,
+                std::string                *error);
+
+    // PRIVATE CLASS METHODS
+
+    // Load into the specified `constant` the native form of the specified
+    // `val`, accepting the same types as `loadElement`.  Return 0 on
+    // success, or a non-zero value after loading a description of the
+    // problem into the specified `error`.
+    static int compileConstant(Constant      *constant,
+                               Local<Value>   val,
+                               bool           forArray,
+                               std::string   *error);
+
+    // Set the specified `constant` into the specified `elem`, appending it
+    // if the specified `forArray` is true.
+    static void loadConstant(blpapi::Element *elem,
+                             const Constant&  constant,
+                             bool             forArray);
+
+  public:
+    // CLASS METHODS
+    static void Initialize(Handle<Object> target);
+
+    // Return a new template for the specified `operation` of the specified
+    // `service` of the specified `session`, compiled from the specified
+    // `shape`, or an empty handle after loading a description of the
+    // problem into the specified `error`.  Throw BLPAPI exceptions for
+    // element names the schema does not define.
+    static Local<Object> New(Isolate                *isolate,
+                             Handle<Object>          session,
+                             const blpapi::Service&  service,
+                             const char             *operation,
+                             Local<Object>           shape,
+                             std::string            *error);
+
+    static void Send(const FunctionCallbackInfo<Value>& args);
+
+    // CREATORS
+    ~RequestTemplate();
+};
+
+                            // ---------------------
+                            // class RequestTemplate
+                            // ---------------------
+
+// CLASS DATA
+Eternal<ObjectTemplate> RequestTemplate::s_objectTemplate;
+
+// PRIVATE CREATORS
+RequestTemplate::RequestTemplate(const blpapi::Service&  service,
+                                 const char             *operation)
+: d_service(service)
+, d_operation(operation)
+{
+}
+
+// PRIVATE MANIPULATORS
+int RequestTemplate::compile(Isolate                    *isolate,
+                             const blpapi::Element&      elem,
+                             Local<Object>               shape,
+                             std::vector<blpapi::Name>  *path,
+                             const std::string&          prefix,
+                             std::string                *error)
+{
+    Local<Array> props = shape->GetPropertyNames();
+    for (std::size_t i = 0; i < props->Length(); ++i) {
+        Local<Value> key = props->Get(i);
+        String::Utf8Value keyStr(key);
+        blpapi::Element se = elem.getElement(*keyStr);
+        std::string slot = prefix + *keyStr;
+        path->push_back(se.name());
+
+        Local<Value> v = shape->Get(key);
+        if (v->IsObject() && !v->IsArray() && !v->IsDate()) {
+            if (compile(isolate, se, v->ToObject(), path, slot + ".",
+                        error)) {
+                return 1;
+            }
+        } else {
+            Binding *b = new Binding;
+            d_bindings.push_back(b);
+            b->d_path = *path;
+            if (v->IsNull()) {
+                b->d_key.Reset(isolate, String::NewFromUtf8(
+                                                isolate,
+                                                slot.c_str(),
+                                                String::kInternalizedString));
+            } else {
+                // Load constants into the schema-checked request now, so
+                // that invalid values are reported when the template is
+                // prepared.
+                if (compileConstant(&b->d_constant, v, false, error)) {
+                    return 1;
+                }
+                loadConstant(&se, b->d_constant, false);
+            }
+        }
+        path->pop_back();
+    }
+    return 0;
+}
+
+// PRIVATE CLASS METHODS
+int RequestTemplate::compileConstant(Constant      *constant,
+                                     Local<Value>   val,
+                                     bool           forArray,
+                                     std::string   *error)
+{
+    if (val->IsString()) {
+        constant->d_type = Constant::e_STRING;
+        constant->d_string = *String::Utf8Value(val);
+    } else if (val->IsBoolean()) {
+        constant->d_type = Constant::e_BOOL;
+        constant->d_bool = val->BooleanValue();
+    } else if (val->IsNumber()) {
+        constant->d_type = Constant::e_NUMBER;
+        constant->d_number = val->NumberValue();
+    } else if (val->IsDate()) {
+        constant->d_type = Constant::e_DATETIME;
+        mkdatetime(&constant->d_datetime, val);
+    } else if (val->IsArray()) {
+        constant->d_type = Constant::e_ARRAY;
+        Local<Object> subArray = val->ToObject();
+        const int subArrayLen = Array::Cast(*val)->Length();
+        constant->d_items.resize(subArrayLen);
+        for (int i = 0; i < subArrayLen; ++i) {
+            if (compileConstant(&constant->d_items[i],
+                                subArray->Get(i),
+                                true,
+                                error)) {
+                return 1;
+            }
+        }
+    } else if (val->IsObject()) {
+        constant->d_type = Constant::e_OBJECT;
+        Local<Object> obj = val->ToObject();
+        Local<Array> props = obj->GetPropertyNames();
+        constant->d_items.resize(props->Length());
+        for (std::size_t i = 0; i < props->Length(); ++i) {
+            Local<Value> key = props->Get(i);
+            constant->d_names.push_back(*String::Utf8Value(key));
+            if (compileConstant(&constant->d_items[i],
+                                obj->Get(key),
+                                false,
+                                error)) {
+                return 1;
+            }
+        }
+    } else {
+        if (forArray) {
+            *error = "Array contains invalid type";
+        } else {
+            *error = "Object contains invalid value type.";
+        }
+        return 1;
+    }
+
+    return 0;
+}
+
+void RequestTemplate::loadConstant(blpapi::Element *elem,
+                                   const Constant&  constant,
+                                   bool             forArray)
+{
+    blpapi::Element subElem;
+    switch (constant.d_type) {
+      case Constant::e_STRING: {
+        loadElement(elem, constant.d_string.c_str(), forArray);
+      } break;
+      case Constant::e_BOOL: {
+        loadElement(elem, constant.d_bool, forArray);
+      } break;
+      case Constant::e_NUMBER: {
+        loadElement(elem, constant.d_number, forArray);
+      } break;
+      case Constant::e_DATETIME: {
+        loadElement(elem, constant.d_datetime, forArray);
+      } break;
+      case Constant::e_ARRAY: {
+        if (forArray) {
+            subElem = elem->appendElement();
+            elem = &subElem;
+        }
+        for (std::size_t i = 0; i < constant.d_items.size(); ++i) {
+            loadConstant(elem, constant.d_items[i], true);
+        }
+      } break;
+      case Constant::e_OBJECT: {
+        if (forArray) {
+            subElem = elem->appendElement();
+            elem = &subElem;
+        }
+        for (std::size_t i = 0; i < constant.d_items.size(); ++i) {
+            blpapi::Element member =
+                                 elem->getElement(constant.d_names[i].c_str());
+            loadConstant(&member, constant.d_items[i], false);
+        }
+      } break;
+    }
+}
+
+// CLASS METHODS
+void RequestTemplate::Initialize(Handle<Object> target)
+{
+    Local<ObjectTemplate> objectTemplate;
+    Isolate *isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+    objectTemplate = ObjectTemplate::New(isolate);
+    objectTemplate->SetInternalFieldCount(1);
+    objectTemplate->Set(isolate, "send", FunctionTemplate::New(isolate, Send));
+    s_objectTemplate.Set(isolate, objectTemplate);
+}
+
+Local<Object> RequestTemplate::New(Isolate                *isolate,
+                                   Handle<Object>          session,
+                                   const blpapi::Service&  service,
+                                   const char             *operation,
+                                   Local<Object>           shape,
+                                   std::string            *error)
+{
+    RequestTemplate *rt = new RequestTemplate(service, operation);
+    blpapi::Request request(service.createRequest(operation));
+    std::vector<blpapi::Name> path;
+    int rc;
+    try {
+        rc = rt->compile(isolate, request.asElement(), shape, &path, "",
+                         error);
+    } catch (...) {
+        delete rt;
+        throw;
+    }
+    if (rc) {
+        delete rt;
+        return Local<Object>();
+    }
+
+    rt->d_session_ref.Reset(isolate, session);
+    Local<Object> object = s_objectTemplate.Get(isolate)->NewInstance();
+    rt->Wrap(object);
+    return object;
+}
+
+void RequestTemplate::Send(const FunctionCallbackInfo<Value>& args)
+{
+    Isolate *isolate = args.GetIsolate();
+    EscapableHandleScope scope(isolate);
+
+    if (args.Length() < 1 || !args[0]->IsObject()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Object containing slot values must be provided "
+            "as first parameter.")));
+    }
+    if (args.Length() < 2 || !Session::isCorrelation(args[1])) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Integer, string of digits or object correlation identifier "
+            "must be provided as second parameter.")));
+    }
+    if (args.Length() >= 3 && !args[2]->IsUndefined() &&
+        !args[2]->IsNull() && !args[2]->IsObject()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Optional identity must be an object.")));
+    }
+    if (args.Length() >= 4 && !args[3]->IsUndefined() &&
+        !args[3]->IsNull() && !args[3]->IsString()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Optional request label must be a string.")));
+    }
+    if (args.Length() >= 5 && !args[4]->IsUndefined() &&
+        !args[4]->IsNull() && !args[4]->IsObject()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Optional request options must be an object.")));
+    }
+    if (args.Length() > 5) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Function expects at most five arguments.")));
+    }
+
+    RequestTemplate *rt = ObjectWrap::Unwrap<RequestTemplate>(args.This());
+    Session *session = ObjectWrap::Unwrap<Session>(
+                              Local<Object>::New(isolate, rt->d_session_ref));
+
+    if (!session->d_session || session->d_destroy) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Session has already been destroyed.")));
+    }
+
+    Local<Object> values = args[0]->ToObject();
+
+    BLPAPI_EXCEPTION_TRY
+
+    blpapi::Request request(
+                       rt->d_service.createRequest(rt->d_operation.c_str()));
+    blpapi::Element root = request.asElement();
+    std::string error;
+    for (std::size_t i = 0; i < rt->d_bindings.size(); ++i) {
+        const Binding& b = *rt->d_bindings[i];
+        blpapi::Element e = root;
+        for (std::size_t j = 0; j < b.d_path.size(); ++j) {
+            e = e.getElement(b.d_path[j]);
+        }
+        if (b.d_key.IsEmpty()) {
+            loadConstant(&e, b.d_constant, false);
+            continue;
+        }
+
+        Local<String> key = Local<String>::New(isolate, b.d_key);
+        Local<Value> v = values->Get(key);
+        if (v->IsUndefined()) {
+            error = "Missing value for '";
+            error += *String::Utf8Value(key);
+            error += "'.";
+            RetThrowException(Exception::Error(NEW_STRING(error.c_str())));
+        }
+        if (loadElement(&e, v, false, &error)) {
+            RetThrowException(Exception::Error(NEW_STRING(error.c_str())));
+        }
+    }
+
+    session->sendRequest(args,
+                         request,
+                         session->toCorrelationId(isolate, args[1]),
+                         2);
+
+    BLPAPI_EXCEPTION_CATCH_RETURN
+
+    args.GetReturnValue().Set(scope.Escape(args[1]));
+}
+
+// CREATORS
+RequestTemplate::~RequestTemplate()
+{
+    for (std::size_t i = 0; i < d_bindings.size(); ++i) {
+        d_bindings[i]->d_key.Reset();
+        delete d_bindings[i];
+    }
+    d_session_ref.Reset();
+}
+
+Persistent<String> Session::s_emit;
+Persistent<String> Session::s_event_type;
+Persistent<String> Session::s_message_type;
+Persistent<String> Session::s_topic_name;
+Persistent<String> Session::s_correlations;
+Persistent<String> Session::s_value;
+Persistent<String> Session::s_class_id;
+Persistent<String> Session::s_data;
+Persistent<String> Session::s_identity;
+Persistent<String> Session::s_queue_depth;
+Persistent<String> Session::s_queue_size;
+Persistent<String> Session::s_dropped;
+Persistent<String> Session::s_conflated;
+Persistent<String> Session::s_batch;
+Persistent<String> Session::s_codes;
+Persistent<String> Session::s_values;
+Persistent<String> Session::s_stats;
+Persistent<String> Session::s_key;
+Persistent<String> Session::s_error;
+Persistent<String> Session::s_cached;
+Persistent<String> Session::s_time_received;
+Persistent<String> Session::s_time_enqueued;
+Persistent<String> Session::s_time_dispatched;
+Eternal<ObjectTemplate> Session::s_message_template;
+
+Session::Session(
+                 const FunctionCallbackInfo<Value>& args,
+                 const blpapi::SessionOptions& options,
+                 unsigned int queueSize)
+    : d_isolate(args.GetIsolate())
+    , d_options(options)
+    , d_async(new uv_async_t)
+    , d_que(queueSize)
+    , d_msg_iter(NULL)
+    , d_max_dispatch_messages(0)
+    , d_max_dispatch_time(0)
+    , d_slow_consumer_policy(BLOCK)
+    , d_hi_water_mark(0)
+    , d_lo_water_mark(0)
+    , d_slow_consumer(false)
+    , d_update_window(0)
+    , d_dropped(0)
+    , d_conflated(0)
+    , d_batch_length(0)
+    , d_batch_events(0)
+    , d_max_batch_events(0)
+    , d_lazy_data(false)
+    , d_live_data(NULL)
+    , d_project_fields(false)
+    , d_use_data_templates(false)
+    , d_merge_updates(false)
+    , d_cache_last_values(false)
+    , d_next_correlation_key(1)
+    , d_unused_correlations(0)
+    , d_deferred_correlations(0)
+    , d_record_times(false)
+    , d_last_message_stats(NULL)
+    , d_max_depth(0)
+    , d_stats_start(uv_hrtime())
+    , d_started(false)
+    , d_stopped(false)
+    , d_dispatching(false)
+    , d_destroy(false)
+{
+    BLPAPI_EXCEPTION_TRY
+    d_session = new blpapi::Session(d_options, this);
+    BLPAPI_EXCEPTION_CATCH
+
+    // Each session owns its async handle so that a wakeup posted by one
+    // session's dispatcher thread can never be coalesced with, and lost
+    // behind, a wakeup posted by another session.  The handle keeps the
+    // event loop alive until it is closed.
+    uv_async_init(uv_default_loop(), d_async, Session::processEvents);
+    d_async->data = this;
+}
+
+Session::~Session()
+{
+    // If the `Session` object in Javascript is collected without `stop()`
+    // or `destroy()` being called, the underlying `blpapi::Session` still
+    // needs to be cleaned up.
+    delete d_msg_iter;
+    d_msg_iter = NULL;
+    while (d_live_data) {
+        d_live_data->detach();
+    }
+    d_merged_updates.clear();
+    clearChunks();
+    clearAuthorizations(false);
+    clearUserAuthorizations(false);
+    d_que.close();
+    d_que.clear();
+    if (d_session) {
+        delete d_session;
+        d_session = NULL;
+    }
+
+    // The async handle is normally closed once the `blpapi::Session` has
+    // been deleted, as no further events can be posted after that point.
+    if (d_async) {
+        uv_close(reinterpret_cast<uv_handle_t *>(d_async), closeAsync);
+        d_async = NULL;
+    }
+
+    clearCallbacks();
+    clearCorrelations();
+    clearInterned();
+    clearStats();
+}
+
+void
+Session::Initialize(Handle<Object> target)
+{
+    Isolate *isolate = Isolate::GetCurrent();
+    HandleScope scope(isolate);
+    Local<FunctionTemplate> t = FunctionTemplate::New(isolate, Session::New);
+
+    t->InstanceTemplate()->SetInternalFieldCount(1);
+
+    NODE_SET_PROTOTYPE_METHOD(t, "start", Start);
+    NODE_SET_PROTOTYPE_METHOD(t, "authorize", Authorize);
+    NODE_SET_PROTOTYPE_METHOD(t, "authorizeUser", AuthorizeUser);
+    NODE_SET_PROTOTYPE_METHOD(t, "authorizeUsers", AuthorizeUsers);
+    NODE_SET_PROTOTYPE_METHOD(t, "stop", Stop);
+    NODE_SET_PROTOTYPE_METHOD(t, "destroy", Destroy);
+    NODE_SET_PROTOTYPE_METHOD(t, "openService", OpenService);
+    NODE_SET_PROTOTYPE_METHOD(t, "subscribe", Subscribe);
+    NODE_SET_PROTOTYPE_METHOD(t, "resubscribe", Resubscribe);
+    NODE_SET_PROTOTYPE_METHOD(t, "unsubscribe", Unsubscribe);
+    NODE_SET_PROTOTYPE_METHOD(t, "request", Request);
+    NODE_SET_PROTOTYPE_METHOD(t, "prepareRequest", PrepareRequest);
+    NODE_SET_PROTOTYPE_METHOD(t, "snapshot", Snapshot);
+    NODE_SET_PROTOTYPE_METHOD(t, "stats", Stats);
+
+    target->Set(String::NewFromUtf8(isolate, "Session",
+                                    v8::String::kInternalizedString),
+                t->GetFunction());
+
+#define NODE_PSYMBOL(x) \
+    String::NewFromUtf8(isolate, x, String::kInternalizedString)
     s_emit.Reset(isolate, NODE_PSYMBOL("emit"));
     s_event_type.Reset(isolate, NODE_PSYMBOL("eventType"));
     s_message_type.Reset(isolate, NODE_PSYMBOL("messageType"));
@@ -421,7 +1939,37 @@ Session::Initialize(Handle<Object> target)
     s_class_id.Reset(isolate, NODE_PSYMBOL("classId"));
     s_data.Reset(isolate, NODE_PSYMBOL("data"));
     s_identity.Reset(isolate, NODE_PSYMBOL("identity"));
+    s_queue_depth.Reset(isolate, NODE_PSYMBOL("queueDepth"));
+    s_queue_size.Reset(isolate, NODE_PSYMBOL("queueSize"));
+    s_dropped.Reset(isolate, NODE_PSYMBOL("dropped"));
+    s_conflated.Reset(isolate, NODE_PSYMBOL("conflated"));
+    s_batch.Reset(isolate, NODE_PSYMBOL("batch"));
+    s_codes.Reset(isolate, NODE_PSYMBOL("codes"));
+    s_values.Reset(isolate, NODE_PSYMBOL("values"));
+    s_stats.Reset(isolate, NODE_PSYMBOL("stats"));
+    s_key.Reset(isolate, NODE_PSYMBOL("key"));
+    s_error.Reset(isolate, NODE_PSYMBOL("error"));
+    s_cached.Reset(isolate, NODE_PSYMBOL("cached"));
+    s_time_received.Reset(isolate, NODE_PSYMBOL("timeReceived"));
+    s_time_enqueued.Reset(isolate, NODE_PSYMBOL("timeEnqueued"));
+    s_time_dispatched.Reset(isolate, NODE_PSYMBOL("timeDispatched"));
 #undef NODE_PSYMBOL
+
+    // Every message shares the same shape, so declare its properties up
+    // front and let each message be created in a single allocation.
+    Local<ObjectTemplate> messageTemplate = ObjectTemplate::New(isolate);
+    const PropertyAttribute attr = (PropertyAttribute)(ReadOnly | DontDelete);
+    messageTemplate->Set(Local<String>::New(isolate, s_event_type),
+                         Undefined(isolate), attr);
+    messageTemplate->Set(Local<String>::New(isolate, s_message_type),
+                         Undefined(isolate), attr);
+    messageTemplate->Set(Local<String>::New(isolate, s_topic_name),
+                         Undefined(isolate), attr);
+    messageTemplate->Set(Local<String>::New(isolate, s_correlations),
+                         Undefined(isolate), attr);
+    messageTemplate->Set(Local<String>::New(isolate, s_data),
+                         Undefined(isolate));
+    s_message_template.Set(isolate, messageTemplate);
 }
 
 void
@@ -431,11 +1979,65 @@ Session::New(const FunctionCallbackInfo<Value>& args)
 
     std::string serverHost;
     int serverPort = 0;
+    std::vector<std::pair<std::string, unsigned short> > serverAddresses;
+    unsigned int connectTimeout = 0;
+    int numStartAttempts = 0;
+    bool hasAutoRestart = false;
+    bool autoRestart = false;
+    int clientMode = -1;
+    std::string defaultSubscriptionService;
+    std::string defaultTopicPrefix;
+    bool hasDefaultTopicPrefix = false;
+    bool allowMultipleCorrelators = false;
+    int maxPendingRequests = 0;
+    bool hasKeepAliveEnabled = false;
+    bool keepAliveEnabled = true;
+    int keepAliveInactivityTime = -1;
+    int keepAliveResponseTimeout = -1;
     std::string authenticationOptions;
+    unsigned int maxMessagesPerDispatch = 0;
+    unsigned int maxDispatchMicroseconds = 0;
+    unsigned int nativeQueueSize = 8192;
+    SlowConsumerPolicy slowConsumerPolicy = BLOCK;
+    double maxEventQueueSize = 0;
+    double hiWaterMark = 0.75;
+    double loWaterMark = 0.5;
+    bool hasHiWaterMark = false;
+    bool hasLoWaterMark = false;
+    unsigned int batchEvents = 0;
+    bool lazyData = false;
+    bool projectFields = false;
+    bool dataTemplates = false;
+    bool mergeUpdates = false;
+    bool lastValueCache = false;
+    bool recordReceiveTimes = false;
 
     if (args.Length() > 0 && args[0]->IsObject()) {
         Local<Object> o = args[0]->ToObject();
 
+        // Capture the optional list of server addresses to fail over
+        // between, in order of preference
+        Local<Value> sa = o->Get(NEW_STRING("serverAddresses"));
+        if (!sa->IsUndefined()) {
+            if (!sa->IsArray() || 0 == Array::Cast(*sa)->Length()) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'serverAddresses' must be a non-empty array.")));
+            }
+            Local<Object> list = sa->ToObject();
+            const uint32_t count = Array::Cast(*sa)->Length();
+            serverAddresses.resize(count);
+            for (uint32_t i = 0; i < count; ++i) {
+                if (!loadServerAddress(args.GetIsolate(),
+                                       list->Get(i),
+                                       &serverAddresses[i].first,
+                                       &serverAddresses[i].second)) {
+                    RetThrowException(Exception::Error(NEW_STRING(
+                        "Option 'serverAddresses' must contain 'host:port' "
+                        "strings or objects with 'host' and 'port'.")));
+                }
+            }
+        }
+
         // Capture the host name
         Local<Value> h = o->Get(NEW_STRING("host"));
         if (h->IsUndefined())
@@ -445,10 +2047,6 @@ Session::New(const FunctionCallbackInfo<Value>& args)
             if (hv.length())
                 serverHost.assign(*hv, hv.length());
         }
-        if (0 == serverHost.length()) {
-            RetThrowException(Exception::Error(NEW_STRING(
-                "Configuration missing 'serverHost'.")));
-        }
 
         // Capture the port number
         Local<Value> p = o->Get(NEW_STRING("port"));
@@ -456,11 +2054,129 @@ Session::New(const FunctionCallbackInfo<Value>& args)
             p = o->Get(NEW_STRING("serverPort"));
         if (p->IsInt32())
             serverPort = p->ToInt32()->Value();
-        if (0 == serverPort) {
+
+        if (!serverAddresses.empty()) {
+            if (serverHost.length() || !p->IsUndefined()) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'serverAddresses' cannot be combined with "
+                    "'serverHost' or 'serverPort'.")));
+            }
+        } else if (0 == serverHost.length()) {
+            RetThrowException(Exception::Error(NEW_STRING(
+                "Configuration missing 'serverHost'.")));
+        } else if (0 == serverPort) {
             RetThrowException(Exception::Error(NEW_STRING(
                 "Configuration missing non-zero 'serverPort'.")));
         }
 
+        // Capture the optional connection establishment settings
+        Local<Value> ct = o->Get(NEW_STRING("connectTimeout"));
+        if (!ct->IsUndefined()) {
+            if (!ct->IsUint32() || 0 == ct->Uint32Value() ||
+                ct->Uint32Value() > 120000) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'connectTimeout' must be an integer number of "
+                    "milliseconds from 1 to 120000.")));
+            }
+            connectTimeout = ct->Uint32Value();
+        }
+        Local<Value> ns = o->Get(NEW_STRING("numStartAttempts"));
+        if (!ns->IsUndefined()) {
+            if (!ns->IsInt32() || ns->Int32Value() <= 0) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'numStartAttempts' must be a positive "
+                    "integer.")));
+            }
+            numStartAttempts = ns->Int32Value();
+        }
+        Local<Value> ar = o->Get(NEW_STRING("autoRestartOnDisconnection"));
+        if (!ar->IsUndefined()) {
+            autoRestart = ar->BooleanValue();
+            hasAutoRestart = true;
+        }
+        Local<Value> cm = o->Get(NEW_STRING("clientMode"));
+        if (!cm->IsUndefined()) {
+            String::Utf8Value cmv(cm);
+            std::string mode(*cmv ? *cmv : "");
+            if ("auto" == mode) {
+                clientMode = blpapi::SessionOptions::AUTO;
+            } else if ("dapi" == mode) {
+                clientMode = blpapi::SessionOptions::DAPI;
+            } else if ("sapi" == mode) {
+                clientMode = blpapi::SessionOptions::SAPI;
+            } else {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'clientMode' must be one of 'auto', 'dapi' or "
+                    "'sapi'.")));
+            }
+        }
+
+        // Capture the optional keep-alive settings
+        Local<Value> ke = o->Get(NEW_STRING("keepAliveEnabled"));
+        if (!ke->IsUndefined()) {
+            keepAliveEnabled = ke->BooleanValue();
+            hasKeepAliveEnabled = true;
+        }
+        Local<Value> ki =
+                    o->Get(NEW_STRING("defaultKeepAliveInactivityTime"));
+        if (!ki->IsUndefined()) {
+            if (!ki->IsInt32() || ki->Int32Value() < 0) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'defaultKeepAliveInactivityTime' must be a "
+                    "non-negative integer.")));
+            }
+            keepAliveInactivityTime = ki->Int32Value();
+        }
+        Local<Value> kr =
+                    o->Get(NEW_STRING("defaultKeepAliveResponseTimeout"));
+        if (!kr->IsUndefined()) {
+            if (!kr->IsInt32() || kr->Int32Value() < 0) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'defaultKeepAliveResponseTimeout' must be a "
+                    "non-negative integer.")));
+            }
+            keepAliveResponseTimeout = kr->Int32Value();
+        }
+
+        // Capture the optional qualification of subscription strings
+        Local<Value> ds = o->Get(NEW_STRING("defaultSubscriptionService"));
+        if (!ds->IsUndefined()) {
+            String::Utf8Value dsv(ds);
+            if (*dsv)
+                defaultSubscriptionService.assign(*dsv, dsv.length());
+            if (!ds->IsString() ||
+                !isServiceName(defaultSubscriptionService)) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'defaultSubscriptionService' must be a service "
+                    "name such as '//blp/mktdata'.")));
+            }
+        }
+        Local<Value> dp = o->Get(NEW_STRING("defaultTopicPrefix"));
+        if (!dp->IsUndefined()) {
+            if (!dp->IsString()) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'defaultTopicPrefix' must be a string.")));
+            }
+            String::Utf8Value dpv(dp);
+            defaultTopicPrefix.assign(*dpv, dpv.length());
+            hasDefaultTopicPrefix = true;
+        }
+        Local<Value> mc = o->Get(NEW_STRING("allowMultipleCorrelatorsPerMsg"));
+        if (!mc->IsUndefined()) {
+            allowMultipleCorrelators = mc->BooleanValue();
+        }
+
+        // Capture the optional limit on outstanding requests
+        Local<Value> mp = o->Get(NEW_STRING("maxPendingRequests"));
+        if (!mp->IsUndefined()) {
+            if (!mp->IsInt32() || mp->Int32Value() <= 0) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'maxPendingRequests' must be a positive "
+                    "integer.")));
+            }
+            maxPendingRequests = mp->Int32Value();
+        }
+
         // Capture optional authentication options
         Local<Value> ao = o->Get(NEW_STRING("authenticationOptions"));
         if (!ao->IsUndefined()) {
@@ -468,13 +2184,211 @@ Session::New(const FunctionCallbackInfo<Value>& args)
             if (aov.length())
                 authenticationOptions.assign(*aov, aov.length());
         }
+
+        // Capture the optional per-wakeup dispatch budget
+        Local<Value> mm = o->Get(NEW_STRING("maxMessagesPerDispatch"));
+        if (!mm->IsUndefined()) {
+            if (!mm->IsUint32()) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'maxMessagesPerDispatch' must be a "
+                    "non-negative integer.")));
+            }
+            maxMessagesPerDispatch = mm->Uint32Value();
+        }
+        Local<Value> mt = o->Get(NEW_STRING("maxDispatchMicroseconds"));
+        if (!mt->IsUndefined()) {
+            if (!mt->IsUint32()) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'maxDispatchMicroseconds' must be a "
+                    "non-negative integer.")));
+            }
+            maxDispatchMicroseconds = mt->Uint32Value();
+        }
+
+        // Capture the optional capacity of the queue between the BLPAPI
+        // dispatcher thread and the Javascript thread
+        Local<Value> qs = o->Get(NEW_STRING("nativeQueueSize"));
+        if (!qs->IsUndefined()) {
+            if (!qs->IsUint32() || 0 == qs->Uint32Value()) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'nativeQueueSize' must be a positive integer.")));
+            }
+            nativeQueueSize = qs->Uint32Value();
+        }
+
+        // Capture the optional slow consumer handling
+        Local<Value> sp = o->Get(NEW_STRING("slowConsumerPolicy"));
+        if (!sp->IsUndefined()) {
+            String::Utf8Value spv(sp);
+            std::string policy(*spv ? *spv : "");
+            if ("block" == policy) {
+                slowConsumerPolicy = BLOCK;
+            } else if ("dropOldest" == policy) {
+                slowConsumerPolicy = DROP_OLDEST;
+            } else if ("conflate" == policy) {
+                slowConsumerPolicy = CONFLATE;
+            } else {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'slowConsumerPolicy' must be one of 'block', "
+                    "'dropOldest' or 'conflate'.")));
+            }
+        }
+        Local<Value> mq = o->Get(NEW_STRING("maxEventQueueSize"));
+        if (!mq->IsUndefined()) {
+            if (!mq->IsUint32() || 0 == mq->Uint32Value()) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'maxEventQueueSize' must be a positive "
+                    "integer.")));
+            }
+            maxEventQueueSize = mq->Uint32Value();
+        }
+        Local<Value> hw = o->Get(NEW_STRING("slowConsumerWarningHiWaterMark"));
+        if (!hw->IsUndefined()) {
+            hiWaterMark = hw->NumberValue();
+            if (!hw->IsNumber() || !(hiWaterMark > 0 && hiWaterMark <= 1)) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'slowConsumerWarningHiWaterMark' must be a "
+                    "number greater than 0 and at most 1.")));
+            }
+            hasHiWaterMark = true;
+        }
+        Local<Value> lw = o->Get(NEW_STRING("slowConsumerWarningLoWaterMark"));
+        if (!lw->IsUndefined()) {
+            loWaterMark = lw->NumberValue();
+            if (!lw->IsNumber() || !(loWaterMark >= 0 && loWaterMark < 1)) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'slowConsumerWarningLoWaterMark' must be a "
+                    "number of at least 0 and less than 1.")));
+            }
+            hasLoWaterMark = true;
+        }
+        if (loWaterMark >= hiWaterMark) {
+            RetThrowException(Exception::Error(NEW_STRING(
+                "Option 'slowConsumerWarningLoWaterMark' must be less than "
+                "'slowConsumerWarningHiWaterMark'.")));
+        }
+
+        // Capture the optional batch delivery mode
+        Local<Value> be = o->Get(NEW_STRING("batchEvents"));
+        if (!be->IsUndefined()) {
+            if (!be->IsUint32()) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'batchEvents' must be a non-negative integer.")));
+            }
+            batchEvents = be->Uint32Value();
+        }
+
+        // Capture the optional lazy conversion of message data
+        Local<Value> ld = o->Get(NEW_STRING("lazyData"));
+        if (!ld->IsUndefined()) {
+            lazyData = ld->BooleanValue();
+        }
+
+        // Capture the optional projection of subscription data
+        Local<Value> pf = o->Get(NEW_STRING("projectSubscriptionFields"));
+        if (!pf->IsUndefined()) {
+            projectFields = pf->BooleanValue();
+        }
+
+        // Capture the optional use of per-message type data templates
+        Local<Value> dtv = o->Get(NEW_STRING("dataTemplates"));
+        if (!dtv->IsUndefined()) {
+            dataTemplates = dtv->BooleanValue();
+        }
+
+        // Capture the optional merging of queued subscription updates
+        Local<Value> mu = o->Get(NEW_STRING("mergeUpdates"));
+        if (!mu->IsUndefined()) {
+            mergeUpdates = mu->BooleanValue();
+        }
+
+        // Capture the optional cache of the last subscription field values
+        Local<Value> lvc = o->Get(NEW_STRING("lastValueCache"));
+        if (!lvc->IsUndefined()) {
+            lastValueCache = lvc->BooleanValue();
+        }
+
+        // Capture the optional recording of message times
+        Local<Value> rt =
+                   o->Get(NEW_STRING("recordSubscriptionDataReceiveTimes"));
+        if (!rt->IsUndefined()) {
+            recordReceiveTimes = rt->BooleanValue();
+        }
     } else {
         RetThrowException(Exception::Error(NEW_STRING(
             "Configuration object must be passed as parameter.")));
     }
 
-    Session *session = new Session(args, serverHost, serverPort,
-                                   authenticationOptions);
+    blpapi::SessionOptions options;
+
+    BLPAPI_EXCEPTION_TRY
+    if (serverAddresses.empty()) {
+        options.setServerHost(serverHost.c_str());
+        options.setServerPort(serverPort);
+    }
+    for (std::size_t i = 0; i < serverAddresses.size(); ++i) {
+        options.setServerAddress(serverAddresses[i].first.c_str(),
+                                 serverAddresses[i].second,
+                                 i);
+    }
+    if (connectTimeout)
+        options.setConnectTimeout(connectTimeout);
+    if (numStartAttempts)
+        options.setNumStartAttempts(numStartAttempts);
+    if (hasAutoRestart)
+        options.setAutoRestartOnDisconnection(autoRestart);
+    if (clientMode >= 0)
+        options.setClientMode(clientMode);
+    if (hasKeepAliveEnabled)
+        options.setKeepAliveEnabled(keepAliveEnabled);
+    if (keepAliveInactivityTime >= 0)
+        options.setDefaultKeepAliveInactivityTime(keepAliveInactivityTime);
+    if (keepAliveResponseTimeout >= 0)
+        options.setDefaultKeepAliveResponseTimeout(keepAliveResponseTimeout);
+    if (defaultSubscriptionService.length())
+        options.setDefaultSubscriptionService(
+                                        defaultSubscriptionService.c_str());
+    if (hasDefaultTopicPrefix)
+        options.setDefaultTopicPrefix(defaultTopicPrefix.c_str());
+    if (allowMultipleCorrelators)
+        options.setAllowMultipleCorrelatorsPerMsg(true);
+    if (maxPendingRequests)
+        options.setMaxPendingRequests(maxPendingRequests);
+    if (authenticationOptions.length())
+        options.setAuthenticationOptions(authenticationOptions.c_str());
+    if (maxEventQueueSize)
+        options.setMaxEventQueueSize(static_cast<size_t>(maxEventQueueSize));
+    if (hasHiWaterMark)
+        options.setSlowConsumerWarningHiWaterMark(
+                                           static_cast<float>(hiWaterMark));
+    if (hasLoWaterMark)
+        options.setSlowConsumerWarningLoWaterMark(
+                                           static_cast<float>(loWaterMark));
+    if (recordReceiveTimes)
+        options.setRecordSubscriptionDataReceiveTimes(true);
+    BLPAPI_EXCEPTION_CATCH_RETURN
+
+    Session *session = new Session(args, options, nativeQueueSize);
+    session->d_max_dispatch_messages = maxMessagesPerDispatch;
+    session->d_max_dispatch_time =
+                       static_cast<uint64_t>(maxDispatchMicroseconds) * 1000;
+    session->d_max_batch_events = batchEvents;
+    session->d_lazy_data = lazyData;
+    session->d_project_fields = projectFields;
+    session->d_use_data_templates = dataTemplates;
+    session->d_merge_updates = mergeUpdates;
+    session->d_cache_last_values = lastValueCache;
+    session->d_record_times = recordReceiveTimes;
+
+    // The native queue reuses the SDK's water marks, as fractions of its
+    // own capacity, to detect a slow consumer.
+    const unsigned int capacity = session->d_que.capacity();
+    session->d_slow_consumer_policy = slowConsumerPolicy;
+    session->d_hi_water_mark =
+                   static_cast<unsigned int>(std::ceil(hiWaterMark * capacity));
+    session->d_lo_water_mark =
+                   static_cast<unsigned int>(loWaterMark * capacity);
+
     session->Wrap(args.This());
     args.GetReturnValue().Set(scope.Escape(args.This()));
 }
@@ -506,6 +2420,14 @@ Session::Start(const FunctionCallbackInfo<Value>& args)
     session->d_session_ref.Reset(args.GetIsolate(), args.This());
     session->d_started = true;
 
+    // Look up the `emit` function once rather than for every message.
+    Local<Value> emit =
+        args.This()->Get(Local<String>::New(args.GetIsolate(), s_emit));
+    if (emit->IsFunction()) {
+        session->d_emit.Reset(args.GetIsolate(),
+                              Local<Function>::Cast(emit));
+    }
+
     args.GetReturnValue().Set(scope.Escape(args.This()));
 }
 
@@ -520,10 +2442,10 @@ Session::Authorize(const FunctionCallbackInfo<Value>& args)
         RetThrowException(Exception::Error(NEW_STRING(
             "Service URI string must be provided as first parameter.")));
     }
-    if (args.Length() < 2 || !args[1]->IsInt32()) {
+    if (args.Length() < 2 || !isCorrelation(args[1])) {
         RetThrowException(Exception::Error(NEW_STRING(
-            "Integer correlation identifier must be provided as second "
-            "parameter.")));
+            "Integer, string of digits or object correlation identifier "
+            "must be provided as second parameter.")));
     }
     if (args.Length() > 2) {
         RetThrowException(Exception::Error(NEW_STRING(
@@ -533,8 +2455,6 @@ Session::Authorize(const FunctionCallbackInfo<Value>& args)
     Local<String> s = args[0]->ToString();
     String::Utf8Value uriv(s);
 
-    int cidi = args[1]->Int32Value();
-
     Session* session = ObjectWrap::Unwrap<Session>(args.This());
 
     if (!session->d_session || session->d_destroy) {
@@ -542,50 +2462,27 @@ Session::Authorize(const FunctionCallbackInfo<Value>& args)
             "Session has already been destroyed.")));
     }
 
-    BLPAPI_EXCEPTION_TRY
-
-    blpapi::EventQueue tokenEventQueue;
-    blpapi::CorrelationId tokenCid(static_cast<void*>(&tokenEventQueue));
-    session->d_session->generateToken(tokenCid, &tokenEventQueue);
-
-    std::string token;
-    blpapi::Event ev = tokenEventQueue.nextEvent();
-    if (blpapi::Event::TOKEN_STATUS == ev.eventType() ||
-        blpapi::Event::REQUEST_STATUS == ev.eventType()) {
-        blpapi::MessageIterator msgIter(ev);
-        while (msgIter.next()) {
-            blpapi::Message msg = msgIter.message();
-            if ("TokenGenerationSuccess" == msg.messageType()) {
-                token = msg.getElementAsString("token");
-            } else {
-                std::stringstream ss;
-                ss << "Failed to generate token: " << msg.getElement("reason");
-                std::string s = ss.str();
-                RetThrowException(Exception::Error(NEW_STRING(s.c_str())));
-            }
-        }
-    }
-    if (0 == token.length()) {
-        RetThrowException(Exception::Error(NEW_STRING(
-            "Failed to get token.")));
-    }
-
-    blpapi::Service authService = session->d_session->getService(*uriv);
-    blpapi::Request authRequest = authService.createAuthorizationRequest(
-                                                       "AuthorizationRequest");
-    authRequest.set("token", token.c_str());
+    // The token is delivered as a `TOKEN_STATUS` event through the event
+    // queue, upon which the authorization request is sent.  The returned
+    // promise settles with the authorization response.
+    blpapi::CorrelationId tokenCid;
 
-    session->d_identity = session->d_session->createIdentity();
+    BLPAPI_EXCEPTION_TRY
 
-    blpapi::CorrelationId cid(cidi);
-    session->d_session->sendAuthorizationRequest(authRequest,
-                                                 &session->d_identity,
-                                                 cid);
+    tokenCid = session->d_session->generateToken();
 
     BLPAPI_EXCEPTION_CATCH_RETURN
 
-    args.GetReturnValue().Set(
-        scope.Escape(Integer::New(args.GetIsolate(), cidi)));
+    Local<Promise::Resolver> resolver =
+                                   Promise::Resolver::New(args.GetIsolate());
+    PendingAuthorization *auth = new PendingAuthorization;
+    auth->d_uri = *uriv;
+    auth->d_cid = session->toCorrelationId(args.GetIsolate(), args[1]);
+    session->retainCorrelation(auth->d_cid);
+    auth->d_resolver.Reset(args.GetIsolate(), resolver);
+    session->d_authorizations[tokenCid] = auth;
+
+    args.GetReturnValue().Set(scope.Escape(resolver->GetPromise()));
 }
 
 // Create a new Identity object and send an authorization request for it.
@@ -600,18 +2497,16 @@ Session::AuthorizeUser(const FunctionCallbackInfo<Value>& args)
             "Object containing auth request parameters must be provided as "
             "first parameter.")));
     }
-    if (args.Length() < 2 || !args[1]->IsInt32()) {
+    if (args.Length() < 2 || !isCorrelation(args[1])) {
         RetThrowException(Exception::Error(NEW_STRING(
-            "Integer correlation identifier must be provided as second "
-            "parameter.")));
+            "Integer, string of digits or object correlation identifier "
+            "must be provided as second parameter.")));
     }
     if (args.Length() > 2) {
         RetThrowException(Exception::Error(NEW_STRING(
             "Function expects at most two arguments.")));
     }
 
-    int cidi = args[1]->Int32Value();
-
     Session *session = ObjectWrap::Unwrap<Session>(args.This());
 
     if (!session->d_session || session->d_destroy) {
@@ -628,17 +2523,140 @@ Session::AuthorizeUser(const FunctionCallbackInfo<Value>& args)
     if (loadRequest(&request, args[0], &error)) {
         RetThrowException(Exception::Error(NEW_STRING(error.c_str())));
     }
-    blpapi::CorrelationId cid(cidi);
+    blpapi::CorrelationId cid =
+                         session->toCorrelationId(args.GetIsolate(), args[1]);
     // We need to insert the completed Identity object into the response,
     // so we store it here.
-    blpapi::Identity& identity = session->d_identities[cidi]
+    blpapi::Identity& identity = session->d_identities[cid]
         = session->d_session->createIdentity();
     session->d_session->sendAuthorizationRequest(request, &identity, cid);
+    session->retainCorrelation(cid);
 
     BLPAPI_EXCEPTION_CATCH_RETURN
 
-    args.GetReturnValue().Set(scope.Escape(Integer::New(args.GetIsolate(),
-                                                        cidi)));
+    args.GetReturnValue().Set(scope.Escape(args[1]));
+}
+
+// Authorize many users, each given as `{ key, request }`, sending at most
+// `maxPendingAuthorizations` requests at a time.  Identities are cached by
+// key for `identityTtl` milliseconds, or until their entitlements change,
+// and users with a cached identity are not authorized again.  Return a
+// promise for an array of `{ key, identity, cached }` or `{ key, error }`.
+void
+Session::AuthorizeUsers(const FunctionCallbackInfo<Value>& args)
+{
+    Isolate *isolate = args.GetIsolate();
+    EscapableHandleScope scope(isolate);
+    if (args.Length() < 1 || !args[0]->IsArray()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Array of users must be provided as first parameter.")));
+    }
+    if (args.Length() >= 2 && !args[1]->IsUndefined() &&
+        !args[1]->IsNull() && !args[1]->IsObject()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Optional options must be an object.")));
+    }
+    if (args.Length() > 2) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Function expects at most two arguments.")));
+    }
+
+    unsigned int maxPending = 16;
+    double ttl = 0;
+    if (args.Length() >= 2 && args[1]->IsObject()) {
+        Local<Object> options = args[1]->ToObject();
+        Local<Value> mp = options->Get(NEW_STRING("maxPendingAuthorizations"));
+        if (!mp->IsUndefined()) {
+            if (!mp->IsUint32() || 0 == mp->Uint32Value()) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'maxPendingAuthorizations' must be a positive "
+                    "integer.")));
+            }
+            maxPending = mp->Uint32Value();
+        }
+        Local<Value> tv = options->Get(NEW_STRING("identityTtl"));
+        if (!tv->IsUndefined()) {
+            if (!tv->IsNumber() || tv->NumberValue() < 0) {
+                RetThrowException(Exception::Error(NEW_STRING(
+                    "Option 'identityTtl' must be a non-negative number.")));
+            }
+            ttl = tv->NumberValue();
+        }
+    }
+
+    Session *session = ObjectWrap::Unwrap<Session>(args.This());
+
+    if (!session->d_session || session->d_destroy) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Session has already been destroyed.")));
+    }
+
+    Local<Object> users = args[0]->ToObject();
+    const uint32_t numUsers = Array::Cast(*args[0])->Length();
+    BulkAuthorization *bulk = new BulkAuthorization(numUsers, maxPending, ttl);
+    Local<Promise::Resolver> resolver = Promise::Resolver::New(isolate);
+    bulk->d_resolver.Reset(isolate, resolver);
+    bulk->d_results.Reset(isolate, Array::New(isolate, numUsers));
+
+    const uint64_t now = uv_hrtime();
+    std::string error;
+    try {
+        blpapi::Service service =
+                            session->d_session->getService("//blp/apiauth");
+        for (uint32_t i = 0; i < numUsers; ++i) {
+            Local<Value> u = users->Get(i);
+            Local<Value> key;
+            Local<Value> request;
+            if (u->IsObject()) {
+                key = u->ToObject()->Get(Local<String>::New(isolate, s_key));
+                request = u->ToObject()->Get(NEW_STRING("request"));
+            }
+            if (key.IsEmpty() || !key->IsString() || !request->IsObject()) {
+                error = "Array elements must be objects with a string 'key' "
+                        "and an object 'request'.";
+                break;
+            }
+            bulk->d_keys[i] = *String::Utf8Value(key);
+
+            std::map<std::string, CachedIdentity>::iterator c =
+                session->d_identity_cache.find(bulk->d_keys[i]);
+            if (c != session->d_identity_cache.end()) {
+                if (0 == c->second.d_expiry || now < c->second.d_expiry) {
+                    session->setUserAuthorization(
+                                  isolate,
+                                  bulk,
+                                  i,
+                                  Identity::New(isolate, c->second.d_identity),
+                                  true,
+                                  Handle<Value>());
+                    continue;
+                }
+                session->d_cached_cids.erase(c->second.d_cid);
+                session->d_identity_cache.erase(c);
+            }
+
+            bulk->d_requests[i] = new blpapi::Request(
+                   service.createAuthorizationRequest("AuthorizationRequest"));
+            if (loadRequest(bulk->d_requests[i], request, &error)) {
+                break;
+            }
+            bulk->d_queue.push_back(i);
+        }
+    } catch (...) {
+        // Report the BLPAPI exception once `bulk` is released.
+        delete bulk;
+        BLPAPI_EXCEPTION_TRY
+        throw;
+        BLPAPI_EXCEPTION_CATCH_RETURN
+    }
+    if (!error.empty()) {
+        delete bulk;
+        RetThrowException(Exception::Error(NEW_STRING(error.c_str())));
+    }
+
+    Local<Promise> promise = resolver->GetPromise();
+    session->sendUserAuthorizations(isolate, bulk);
+    args.GetReturnValue().Set(scope.Escape(promise));
 }
 
 void
@@ -692,8 +2710,6 @@ Session::Destroy(const FunctionCallbackInfo<Value>& args)
 
     session->d_session_ref.Reset();
 
-    uv_unref(reinterpret_cast<uv_handle_t *>(&s_async));
-
     // The `blpapi::Session` can not be deleted from within a dispatch
     // loop while a `MessageIterator` still exists.  Instead, indicate
     // it should be destroyed after the dispatching function exits the
@@ -701,8 +2717,11 @@ Session::Destroy(const FunctionCallbackInfo<Value>& args)
     if (session->d_dispatching) {
         session->d_destroy = true;
     } else {
-        delete session->d_session;
-        session->d_session = NULL;
+        session->release();
+
+        uv_close(reinterpret_cast<uv_handle_t *>(session->d_async),
+                 closeAsync);
+        session->d_async = NULL;
     }
 
     args.GetReturnValue().Set(scope.Escape(args.This()));
@@ -717,10 +2736,10 @@ Session::OpenService(const FunctionCallbackInfo<Value>& args)
         RetThrowException(Exception::Error(NEW_STRING(
             "Service URI string must be provided as first parameter.")));
     }
-    if (args.Length() < 2 || !args[1]->IsInt32()) {
+    if (args.Length() < 2 || !isCorrelation(args[1])) {
         RetThrowException(Exception::Error(NEW_STRING(
-            "Integer correlation identifier must be provided as second "
-            "parameter.")));
+            "Integer, string of digits or object correlation identifier "
+            "must be provided as second parameter.")));
     }
     if (args.Length() > 2) {
         RetThrowException(Exception::Error(NEW_STRING(
@@ -730,9 +2749,6 @@ Session::OpenService(const FunctionCallbackInfo<Value>& args)
     Local<String> s = args[0]->ToString();
     String::Utf8Value uriv(s);
 
-    int cidi = args[1]->Int32Value();
-    blpapi::CorrelationId cid(cidi);
-
     Session* session = ObjectWrap::Unwrap<Session>(args.This());
 
     if (!session->d_session || session->d_destroy) {
@@ -740,16 +2756,21 @@ Session::OpenService(const FunctionCallbackInfo<Value>& args)
             "Session has already been destroyed.")));
     }
 
+    blpapi::CorrelationId cid =
+                         session->toCorrelationId(args.GetIsolate(), args[1]);
+
     BLPAPI_EXCEPTION_TRY
     session->d_session->openServiceAsync(*uriv, cid);
+    session->retainCorrelation(cid);
     BLPAPI_EXCEPTION_CATCH_RETURN
 
-    args.GetReturnValue().Set(
-        scope.Escape(Integer::New(args.GetIsolate(), cidi)));
+    args.GetReturnValue().Set(scope.Escape(args[1]));
 }
 
 void
-Session::formFields(std::string* str, Handle<Object> object)
+Session::formFields(std::string* str,
+                    Handle<Object> object,
+                    std::vector<blpapi::Name> *names)
 {
     // Use the HandleScope of the calling function for speed.
 
@@ -757,7 +2778,8 @@ Session::formFields(std::string* str, Handle<Object> object)
 
     std::stringstream ss;
 
-    // Format each array value into the options string "V[&V]"
+    // Format each array value into the options string "V[&V]", and resolve
+    // the field names if requested.
     for (std::size_t i = 0; i < Array::Cast(*object)->Length(); ++i) {
         Local<String> s = object->Get(i)->ToString();
         String::Utf8Value v(s);
@@ -765,6 +2787,8 @@ Session::formFields(std::string* str, Handle<Object> object)
             if (i > 0)
                 ss << ",";
             ss << *v;
+            if (names)
+                names->push_back(blpapi::Name(*v));
         }
     }
 
@@ -842,7 +2866,12 @@ Session::subscribe(const FunctionCallbackInfo<Value>& args, int action)
             "Function expects at most three arguments.")));
     }
 
+    Session* session = ObjectWrap::Unwrap<Session>(args.This());
+
     blpapi::SubscriptionList sl;
+    std::vector<blpapi::CorrelationId> cids;
+    std::vector<std::vector<blpapi::Name> > projections;
+    std::vector<Local<Value> > callbacks;
 
     Local<Object> o = args[0]->ToObject();
     for (std::size_t i = 0; i < Array::Cast(*(args[0]))->Length(); ++i) {
@@ -873,7 +2902,10 @@ Session::subscribe(const FunctionCallbackInfo<Value>& args, int action)
                 "Property 'fields' must be an array of strings.")));
         }
         std::string fields;
-        formFields(&fields, iv->ToObject());
+        std::vector<blpapi::Name> names;
+        formFields(&fields,
+                   iv->ToObject(),
+                   session->d_project_fields && action != 2 ? &names : 0);
 
         // Process 'options' array
         iv = io->Get(NEW_STRING("options"));
@@ -886,19 +2918,31 @@ Session::subscribe(const FunctionCallbackInfo<Value>& args, int action)
         std::string options;
         formOptions(&options, iv);
 
-        // Process 'correlation' int or string
+        // Process 'correlation' integer, string of digits or object
         iv = io->Get(NEW_STRING("correlation"));
-        if (!iv->IsInt32()) {
+        if (!isCorrelation(iv)) {
             RetThrowException(Exception::Error(NEW_STRING(
-                "Property 'correlation' must be an integer.")));
+                "Property 'correlation' must be an integer, a string of "
+                "digits or an object.")));
         }
-        int correlation = iv->Int32Value();
+        blpapi::CorrelationId correlation =
+                                   session->toCorrelationId(args.GetIsolate(),
+                                                            iv);
 
-        sl.add(*secv, fields.c_str(), options.c_str(),
-               blpapi::CorrelationId(correlation));
-    }
+        // Process optional 'callback' function
+        iv = io->Get(NEW_STRING("callback"));
+        if (!iv->IsUndefined() && !iv->IsNull() && !iv->IsFunction()) {
+            RetThrowException(Exception::Error(NEW_STRING(
+                "Property 'callback' must be a function.")));
+        }
 
-    Session* session = ObjectWrap::Unwrap<Session>(args.This());
+        sl.add(*secv, fields.c_str(), options.c_str(), correlation);
+        cids.push_back(correlation);
+        callbacks.push_back(iv);
+        if (session->d_project_fields) {
+            projections.push_back(names);
+        }
+    }
 
     if (!session->d_session || session->d_destroy) {
         RetThrowException(Exception::Error(NEW_STRING(
@@ -927,6 +2971,48 @@ Session::subscribe(const FunctionCallbackInfo<Value>& args, int action)
     }
     BLPAPI_EXCEPTION_CATCH_RETURN
 
+    // Remember the fields of each subscription, so that only those are
+    // converted from its data messages.
+    for (std::size_t i = 0; i < projections.size(); ++i) {
+        if (action == 2 || projections[i].empty()) {
+            session->d_projections.erase(cids[i]);
+        } else {
+            session->d_projections[cids[i]].swap(projections[i]);
+        }
+    }
+
+    // Object correlations are kept for as long as they are subscribed, and
+    // last values are only cached for subscriptions, so that updates still
+    // queued once one is cancelled do not bring its values back.
+    for (std::size_t i = 0; i < cids.size(); ++i) {
+        if (action == 0) {
+            if (session->findObjectCorrelation(cids[i]) &&
+                session->d_subscribed_objects.insert(cids[i]).second) {
+                session->retainCorrelation(cids[i]);
+            }
+            if (session->d_cache_last_values) {
+                session->d_last_values[cids[i]];
+            }
+        } else if (action == 2) {
+            session->forgetSubscription(cids[i]);
+        }
+    }
+
+    // Remember the callback of each subscription, to which its messages
+    // are passed instead of being emitted.
+    for (std::size_t i = 0; i < cids.size() && action != 2; ++i) {
+        std::map<blpapi::CorrelationId, Persistent<Function> *>::iterator it =
+                                          session->d_callbacks.find(cids[i]);
+        if (callbacks[i]->IsFunction()) {
+            if (it == session->d_callbacks.end()) {
+                it = session->d_callbacks.insert(std::make_pair(
+                                cids[i], new Persistent<Function>())).first;
+            }
+            it->second->Reset(args.GetIsolate(),
+                              Local<Function>::Cast(callbacks[i]));
+        }
+    }
+
     args.GetReturnValue().Set(scope.Escape(args.This()));
 }
 
@@ -937,89 +3023,1001 @@ Session::subscribe(const FunctionCallbackInfo<Value>& args, int action)
         Session::func(args, i);                                             \
     }
 
-DEFINE_WRAPPER(Subscribe, subscribe, 0)
-DEFINE_WRAPPER(Resubscribe, subscribe, 1)
-DEFINE_WRAPPER(Unsubscribe, subscribe, 2)
+DEFINE_WRAPPER(Subscribe, subscribe, 0)
+DEFINE_WRAPPER(Resubscribe, subscribe, 1)
+DEFINE_WRAPPER(Unsubscribe, subscribe, 2)
+
+void
+Session::Request(const FunctionCallbackInfo<Value>& args)
+{
+    EscapableHandleScope scope(args.GetIsolate());
+
+    if (args.Length() < 1 || !args[0]->IsString()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Service URI string must be provided as first parameter.")));
+    }
+    if (args.Length() < 2 || !args[1]->IsString()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "String request name must be provided as second parameter.")));
+    }
+    if (args.Length() < 3 || !args[2]->IsObject()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Object containing request parameters must be provided "
+            "as third parameter.")));
+    }
+    if (args.Length() < 4 || !isCorrelation(args[3])) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Integer, string of digits or object correlation identifier "
+            "must be provided as fourth parameter.")));
+    }
+    if (args.Length() >= 5 && !args[4]->IsUndefined() &&
+        !args[4]->IsNull() && !args[4]->IsObject()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Optional identity must be an object.")));
+    }
+    if (args.Length() >= 6 && !args[5]->IsUndefined() &&
+        !args[5]->IsNull() && !args[5]->IsString()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Optional request label must be a string.")));
+    }
+    if (args.Length() >= 7 && !args[6]->IsUndefined() &&
+        !args[6]->IsNull() && !args[6]->IsObject()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Optional request options must be an object.")));
+    }
+    if (args.Length() > 7) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Function expects at most seven arguments.")));
+    }
+
+    Session* session = ObjectWrap::Unwrap<Session>(args.This());
+
+    if (!session->d_session || session->d_destroy) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Session has already been destroyed.")));
+    }
+
+    BLPAPI_EXCEPTION_TRY
+
+    Local<String> uri = args[0]->ToString();
+    String::Utf8Value uriv(uri);
+
+    blpapi::Service service = session->d_session->getService(*uriv);
+
+    Local<String> name = args[1]->ToString();
+    String::Utf8Value namev(name);
+
+    // Split requests for more securities than the optional 'chunkSize'.
+    unsigned int chunkSize = 0;
+    unsigned int maxPendingChunks = 4;
+    Local<Object> securities;
+    if (args.Length() >= 7 && args[6]->IsObject()) {
+        Local<Object> options = args[6]->ToObject();
+        Local<Value> cs = options->Get(NEW_STRING("chunkSize"));
+        Local<Value> mpc = options->Get(NEW_STRING("maxPendingChunks"));
+        if (!cs->IsUndefined() && !cs->IsUint32()) {
+            RetThrowException(Exception::Error(NEW_STRING(
+                "Option 'chunkSize' must be a non-negative integer.")));
+        }
+        if (!mpc->IsUndefined() &&
+            (!mpc->IsUint32() || 0 == mpc->Uint32Value())) {
+            RetThrowException(Exception::Error(NEW_STRING(
+                "Option 'maxPendingChunks' must be a positive integer.")));
+        }
+        if (!cs->IsUndefined()) {
+            chunkSize = cs->Uint32Value();
+        }
+        if (!mpc->IsUndefined()) {
+            maxPendingChunks = mpc->Uint32Value();
+        }
+        Local<Value> sv = args[2]->ToObject()->Get(NEW_STRING("securities"));
+        if (chunkSize && sv->IsArray() &&
+            Array::Cast(*sv)->Length() > chunkSize) {
+            securities = sv->ToObject();
+        }
+    }
+
+    std::string error;
+    blpapi::CorrelationId cid =
+                         session->toCorrelationId(args.GetIsolate(), args[3]);
+
+    if (securities.IsEmpty()) {
+        blpapi::Request request(service.createRequest(*namev));
+        if (loadRequest(&request, args[2], &error)) {
+            RetThrowException(Exception::Error(NEW_STRING(error.c_str())));
+        }
+
+        session->sendRequest(args, request, cid, 4);
+    } else {
+        ChunkedRequest *cr =
+            new ChunkedRequest(cid,
+                               maxPendingChunks,
+                               Array::Cast(*securities)->Length());
+        cr->d_identity = *session->getIdentity(args, 4);
+        if (args.Length() >= 6 && args[5]->IsString()) {
+            cr->d_label = *String::Utf8Value(args[5]->ToString());
+        }
+
+        // Build every chunk up front, so that invalid requests are reported
+        // before anything is sent.
+        Local<Object> params = args[2]->ToObject();
+        Local<Array> keys = params->GetOwnPropertyNames();
+        Local<String> securitiesKey = NEW_STRING("securities");
+        int rc = 0;
+        try {
+            for (uint32_t first = 0;
+                 !rc && first < cr->d_securities;
+                 first += chunkSize) {
+                Local<Object> chunk = Object::New(args.GetIsolate());
+                for (uint32_t i = 0; i < keys->Length(); ++i) {
+                    chunk->Set(keys->Get(i), params->Get(keys->Get(i)));
+                }
+                uint32_t last = std::min(first + chunkSize,
+                                         cr->d_securities);
+                Local<Array> slice =
+                    Array::New(args.GetIsolate(), last - first);
+                for (uint32_t i = first; i < last; ++i) {
+                    slice->Set(i - first, securities->Get(i));
+                }
+                chunk->Set(securitiesKey, slice);
+
+                cr->d_requests.push_back(
+                          new blpapi::Request(service.createRequest(*namev)));
+                cr->d_sent.push_back(0);
+                rc = loadRequest(cr->d_requests.back(), chunk, &error);
+            }
+        } catch (...) {
+            delete cr;
+            throw;
+        }
+        if (rc) {
+            delete cr;
+            RetThrowException(Exception::Error(NEW_STRING(error.c_str())));
+        }
+
+        session->sendChunks(cr);
+        if (0 == cr->d_pending) {
+            // Nothing could be sent.
+            error = cr->d_error;
+            delete cr;
+            RetThrowException(Exception::Error(NEW_STRING(error.c_str())));
+        }
+        if (args[6]->ToObject()->Get(NEW_STRING("columnar"))
+                                                         ->BooleanValue()) {
+            session->d_columnar.insert(cid);
+        }
+        session->retainCorrelation(cid);
+    }
+
+    BLPAPI_EXCEPTION_CATCH_RETURN
+
+    args.GetReturnValue().Set(scope.Escape(args[3]));
+}
+
+void
+Session::PrepareRequest(const FunctionCallbackInfo<Value>& args)
+{
+    EscapableHandleScope scope(args.GetIsolate());
+
+    if (args.Length() < 1 || !args[0]->IsString()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Service URI string must be provided as first parameter.")));
+    }
+    if (args.Length() < 2 || !args[1]->IsString()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "String request name must be provided as second parameter.")));
+    }
+    if (args.Length() < 3 || !args[2]->IsObject()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Object containing the request shape must be provided "
+            "as third parameter.")));
+    }
+    if (args.Length() > 3) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Function expects at most three arguments.")));
+    }
+
+    Session* session = ObjectWrap::Unwrap<Session>(args.This());
+
+    if (!session->d_session || session->d_destroy) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Session has already been destroyed.")));
+    }
+
+    Local<Object> t;
+
+    BLPAPI_EXCEPTION_TRY
+
+    Local<String> uri = args[0]->ToString();
+    String::Utf8Value uriv(uri);
+
+    blpapi::Service service = session->d_session->getService(*uriv);
+
+    Local<String> name = args[1]->ToString();
+    String::Utf8Value namev(name);
+
+    std::string error;
+    t = RequestTemplate::New(args.GetIsolate(),
+                             args.This(),
+                             service,
+                             *namev,
+                             args[2]->ToObject(),
+                             &error);
+    if (t.IsEmpty()) {
+        RetThrowException(Exception::Error(NEW_STRING(error.c_str())));
+    }
+
+    BLPAPI_EXCEPTION_CATCH_RETURN
+
+    args.GetReturnValue().Set(scope.Escape(t));
+}
+
+// Return `true` if the specified `value` can be used as a correlation id:
+// an integer, a string of decimal digits for integers beyond the 53 bits
+// a `Number` holds exactly, or an object.
+bool
+Session::isCorrelation(Handle<Value> value)
+{
+    long long integer;
+    return toInteger(value, &integer) || value->IsObject();
+}
+
+// Load into the specified `result` the integer held by the specified
+// `value`, and return `true`, if it is an integral `Number` within 2^53 or
+// a string of decimal digits within 64 bits.  Return `false` otherwise.
+bool
+Session::toInteger(Handle<Value> value, long long *result)
+{
+    static const double MAX_EXACT = 9007199254740992.0;  // 2^53
+
+    if (value->IsNumber()) {
+        double d = value->NumberValue();
+        if (std::floor(d) != d || d > MAX_EXACT || d < -MAX_EXACT) {
+            return false;
+        }
+        *result = static_cast<long long>(d);
+        return true;
+    }
+    if (value->IsString()) {
+        String::Utf8Value v(value);
+        const char *s = *v;
+        if (!s || !*s) {
+            return false;
+        }
+        const char *digits = '-' == *s ? s + 1 : s;
+        if (!*digits || digits[std::strspn(digits, "0123456789")]) {
+            return false;
+        }
+        errno = 0;
+        *result = std::strtoll(s, 0, 10);
+        return ERANGE != errno;
+    }
+    return false;
+}
+
+// Return the correlation id for the specified `value`, for which
+// `isCorrelation` holds.  Objects are looked up in the table of object
+// correlations, and added to it if not found and the optional `create` is
+// `true`; otherwise an unset correlation id is returned.
+blpapi::CorrelationId
+Session::toCorrelationId(Isolate *isolate, Handle<Value> value, bool create)
+{
+    long long integer;
+    if (toInteger(value, &integer)) {
+        return blpapi::CorrelationId(integer);
+    }
+
+    Local<Object> object = value->ToObject();
+    int hash = object->GetIdentityHash();
+    std::pair<ObjectCorrelationMap::iterator,
+              ObjectCorrelationMap::iterator> range =
+                                      d_object_correlations.equal_range(hash);
+    for (ObjectCorrelationMap::iterator it = range.first;
+         it != range.second;
+         ++it) {
+        if (Local<Object>::New(isolate, it->second->d_object)
+                                                   ->StrictEquals(object)) {
+            return blpapi::CorrelationId(it->second->d_key,
+                                         OBJECT_CORRELATION_CLASS_ID);
+        }
+    }
+    if (!create) {
+        return blpapi::CorrelationId();
+    }
+
+    ObjectCorrelation *oc = new ObjectCorrelation;
+    oc->d_object.Reset(isolate, object);
+    oc->d_hash = hash;
+    oc->d_key = d_next_correlation_key++;
+    oc->d_uses = 0;
+    oc->d_released = d_que.popped() + d_que.size();
+    d_object_correlations.insert(std::make_pair(hash, oc));
+    d_correlation_objects[oc->d_key] = oc;
+    ++d_unused_correlations;
+    return blpapi::CorrelationId(oc->d_key, OBJECT_CORRELATION_CLASS_ID);
+}
+
+// Return the object correlation for the specified `cid`, or 0 if `cid` is
+// not an object correlation id or its object was forgotten.
+Session::ObjectCorrelation *
+Session::findObjectCorrelation(const blpapi::CorrelationId& cid) const
+{
+    if (blpapi::CorrelationId::INT_VALUE != cid.valueType() ||
+        OBJECT_CORRELATION_CLASS_ID != cid.classId()) {
+        return 0;
+    }
+    ObjectCorrelationKeyMap::const_iterator it =
+                                  d_correlation_objects.find(cid.asInteger());
+    return it != d_correlation_objects.end() ? it->second : 0;
+}
+
+// Return the value reported to Javascript for the specified `cid`: a
+// `Number`, or a string of digits beyond 2^53, for integers, the object
+// of an object correlation, and `undefined` for anything else.
+Local<Value>
+Session::correlationValue(Isolate *isolate, const blpapi::CorrelationId& cid)
+{
+    static const long long MAX_EXACT = 9007199254740992LL;  // 2^53
+
+    if (OBJECT_CORRELATION_CLASS_ID == cid.classId() &&
+        blpapi::CorrelationId::INT_VALUE == cid.valueType()) {
+        ObjectCorrelation *oc = findObjectCorrelation(cid);
+        if (oc) {
+            return Local<Object>::New(isolate, oc->d_object);
+        }
+        return Undefined(isolate);
+    }
+
+    switch (cid.valueType()) {
+      case blpapi::CorrelationId::INT_VALUE:
+      case blpapi::CorrelationId::AUTOGEN_VALUE: {
+        long long integer = cid.asInteger();
+        if (integer <= MAX_EXACT && integer >= -MAX_EXACT) {
+            return Number::New(isolate, static_cast<double>(integer));
+        }
+        std::ostringstream ss;
+        ss << integer;
+        return String::NewFromUtf8(isolate, ss.str().c_str());
+      }
+      default:
+        break;
+    }
+    return Undefined(isolate);
+}
+
+// Note that the specified `cid` is used by one more request or
+// subscription.
+void
+Session::retainCorrelation(const blpapi::CorrelationId& cid)
+{
+    ObjectCorrelation *oc = findObjectCorrelation(cid);
+    if (oc) {
+        ++oc->d_uses;
+    }
+}
+
+// Note that the specified `cid` is used by one less request or
+// subscription.  Unused objects are forgotten once the events queued at
+// this point have been dispatched, as they may still refer to them.
+void
+Session::releaseCorrelation(const blpapi::CorrelationId& cid)
+{
+    ObjectCorrelation *oc = findObjectCorrelation(cid);
+    if (oc && oc->d_uses && 0 == --oc->d_uses) {
+        oc->d_released = d_que.popped() + d_que.size();
+        ++d_unused_correlations;
+    }
+}
+
+// Forget the object correlations no longer in use that were released
+// before every event still queued.  Unless the specified `force` is
+// `true`, which it is once the event queue drains, only sweep once enough
+// correlations became unused since the last sweep.
+void
+Session::sweepCorrelations(bool force)
+{
+    // Bound the table under a steady load, where the queue never drains,
+    // while only walking it once per this many unused correlations.
+    static const unsigned int SWEEP_INTERVAL = 1024;
+
+    if (force ? 0 == d_unused_correlations + d_deferred_correlations
+              : d_unused_correlations < SWEEP_INTERVAL) {
+        return;
+    }
+    const uint64_t dispatched = d_que.popped();
+    d_unused_correlations = 0;
+    d_deferred_correlations = 0;
+    ObjectCorrelationMap::iterator it = d_object_correlations.begin();
+    while (it != d_object_correlations.end()) {
+        ObjectCorrelation *oc = it->second;
+        if (oc->d_uses) {
+            ++it;
+            continue;
+        }
+        if (oc->d_released > dispatched) {
+            // Still referred to by queued events.
+            ++d_deferred_correlations;
+            ++it;
+            continue;
+        }
+        d_object_correlations.erase(it++);
+        d_correlation_objects.erase(oc->d_key);
+        delete oc;
+    }
+}
+
+// Forget the callback, projection and cached values of the subscription
+// with the specified `cid`, and release its correlation, once it is
+// cancelled or ends.
+void
+Session::forgetSubscription(const blpapi::CorrelationId& cid)
+{
+    if (d_subscribed_objects.erase(cid)) {
+        releaseCorrelation(cid);
+    }
+    std::map<blpapi::CorrelationId, Persistent<Function> *>::iterator it =
+                                                      d_callbacks.find(cid);
+    if (it != d_callbacks.end()) {
+        it->second->Reset();
+        delete it->second;
+        d_callbacks.erase(it);
+    }
+    d_projections.erase(cid);
+    d_last_values.erase(cid);
+}
+
+// Forget every object correlation.
+void
+Session::clearCorrelations()
+{
+    for (ObjectCorrelationMap::iterator it = d_object_correlations.begin();
+         it != d_object_correlations.end();
+         ++it) {
+        delete it->second;
+    }
+    d_object_correlations.clear();
+    d_correlation_objects.clear();
+    d_subscribed_objects.clear();
+    d_unused_correlations = 0;
+    d_deferred_correlations = 0;
+}
+
+// Return an object holding the last value of each of the specified
+// `fields`, or of every field if none are specified, received for the
+// subscription with the specified correlation id.  Fields never received
+// are left out.  Return `undefined` if nothing was received.
+void
+Session::Snapshot(const FunctionCallbackInfo<Value>& args)
+{
+    Isolate *isolate = args.GetIsolate();
+    EscapableHandleScope scope(isolate);
+
+    if (args.Length() < 1 || !isCorrelation(args[0])) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Integer, string of digits or object correlation identifier "
+            "must be provided as first parameter.")));
+    }
+    if (args.Length() >= 2 && !args[1]->IsUndefined() &&
+        !args[1]->IsNull() && !args[1]->IsArray()) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Optional fields must be an array of strings.")));
+    }
+    if (args.Length() > 2) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Function expects at most two arguments.")));
+    }
+
+    Session* session = ObjectWrap::Unwrap<Session>(args.This());
+
+    if (!session->d_cache_last_values) {
+        RetThrowException(Exception::Error(NEW_STRING(
+            "Session option 'lastValueCache' is not enabled.")));
+    }
+
+    LastValueMap::const_iterator it = session->d_last_values.find(
+                       session->toCorrelationId(isolate, args[0], false));
+    if (it == session->d_last_values.end() || it->second.empty()) {
+        return;
+    }
+    const std::vector<FieldValue>& values = it->second;
+
+    Local<Object> o = Object::New(isolate);
+    if (args.Length() >= 2 && args[1]->IsArray()) {
+        Local<Object> fields = args[1]->ToObject();
+        const uint32_t length = Array::Cast(*args[1])->Length();
+        for (uint32_t i = 0; i < length; ++i) {
+            Local<String> field = fields->Get(i)->ToString();
+            blpapi::Name name =
+                            blpapi::Name::findName(*String::Utf8Value(field));
+            std::map<blpapi_Name_t *, std::size_t>::const_iterator f =
+                                  session->d_field_indices.find(name.impl());
+            if (f == session->d_field_indices.end() ||
+                f->second >= values.size() ||
+                FieldValue::NONE == values[f->second].d_type) {
+                continue;
+            }
+            o->Set(field,
+                   session->fieldValueToValue(isolate, values[f->second]));
+        }
+    } else {
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            if (FieldValue::NONE != values[i].d_type) {
+                o->Set(session->internName(isolate,
+                                           session->d_field_names[i]),
+                       session->fieldValueToValue(isolate, values[i]));
+            }
+        }
+    }
+
+    args.GetReturnValue().Set(scope.Escape(o));
+}
 
+// Return the counters of the event queue, and histograms of the time
+// events wait in it and of the time spent on each type of message.  If
+// the optional first argument is `true`, the histograms and the maximum
+// queue depth are reset after being read; the counters never are.
 void
-Session::Request(const FunctionCallbackInfo<Value>& args)
+Session::Stats(const FunctionCallbackInfo<Value>& args)
 {
-    EscapableHandleScope scope(args.GetIsolate());
+    Isolate *isolate = args.GetIsolate();
+    EscapableHandleScope scope(isolate);
 
-    if (args.Length() < 1 || !args[0]->IsString()) {
+    if (args.Length() >= 1 && !args[0]->IsUndefined() &&
+        !args[0]->IsBoolean()) {
         RetThrowException(Exception::Error(NEW_STRING(
-            "Service URI string must be provided as first parameter.")));
+            "Optional reset flag must be a boolean.")));
     }
-    if (args.Length() < 2 || !args[1]->IsString()) {
-        RetThrowException(Exception::Error(NEW_STRING(
-            "String request name must be provided as second parameter.")));
+
+    Session* session = ObjectWrap::Unwrap<Session>(args.This());
+    const EventRing& que = session->d_que;
+    const uint64_t now = uv_hrtime();
+
+    Local<Object> queue = Object::New(isolate);
+    queue->Set(NEW_STRING("enqueued"),
+               Number::New(isolate,
+                           static_cast<double>(que.popped() + que.size())));
+    queue->Set(NEW_STRING("dequeued"),
+               Number::New(isolate, static_cast<double>(que.popped())));
+    queue->Set(NEW_STRING("depth"),
+               Integer::NewFromUnsigned(isolate, que.size()));
+    queue->Set(NEW_STRING("maxDepth"),
+               Integer::NewFromUnsigned(isolate,
+                                        std::max(session->d_max_depth,
+                                                 que.size())));
+    queue->Set(NEW_STRING("capacity"),
+               Integer::NewFromUnsigned(isolate, que.capacity()));
+    queue->Set(NEW_STRING("blocked"),
+               Integer::NewFromUnsigned(isolate, que.blocked()));
+    queue->Set(Local<String>::New(isolate, s_dropped),
+               Number::New(isolate, session->d_dropped));
+    queue->Set(Local<String>::New(isolate, s_conflated),
+               Number::New(isolate, session->d_conflated));
+    queue->Set(NEW_STRING("timeInQueue"),
+               histogramToValue(isolate, session->d_queue_times));
+    if (session->d_record_times) {
+        queue->Set(NEW_STRING("receiveToDispatch"),
+                   histogramToValue(isolate, session->d_receive_times));
     }
-    if (args.Length() < 3 || !args[2]->IsObject()) {
-        RetThrowException(Exception::Error(NEW_STRING(
-            "Object containing request parameters must be provided "
-            "as third parameter.")));
+
+    Local<Object> messages = Object::New(isolate);
+    for (std::map<blpapi_Name_t *, MessageStats *>::const_iterator it =
+             session->d_message_stats.begin();
+         it != session->d_message_stats.end();
+         ++it) {
+        Local<Object> m = Object::New(isolate);
+        m->Set(NEW_STRING("count"),
+               Number::New(isolate, static_cast<double>(
+                                       it->second->d_conversion.count())));
+        m->Set(NEW_STRING("conversion"),
+               histogramToValue(isolate, it->second->d_conversion));
+        m->Set(NEW_STRING("emit"),
+               histogramToValue(isolate, it->second->d_emit));
+        messages->Set(session->internName(isolate, it->second->d_name), m);
     }
-    if (args.Length() < 4 || !args[3]->IsInt32()) {
-        RetThrowException(Exception::Error(NEW_STRING(
-            "Integer correlation identifier must be provided "
-            "as fourth parameter.")));
+
+    Local<Object> o = Object::New(isolate);
+    o->Set(NEW_STRING("seconds"),
+           Number::New(isolate, (now - session->d_stats_start) / 1e9));
+    o->Set(NEW_STRING("queue"), queue);
+    o->Set(NEW_STRING("messages"), messages);
+    o->Set(NEW_STRING("batches"),
+           histogramToValue(isolate, session->d_batch_emit_times));
+
+    if (args.Length() >= 1 && args[0]->BooleanValue()) {
+        session->d_queue_times.reset();
+        session->d_receive_times.reset();
+        session->d_batch_emit_times.reset();
+        for (std::map<blpapi_Name_t *, MessageStats *>::iterator it =
+                 session->d_message_stats.begin();
+             it != session->d_message_stats.end();
+             ++it) {
+            it->second->d_conversion.reset();
+            it->second->d_emit.reset();
+        }
+        session->d_max_depth = 0;
+        session->d_stats_start = now;
     }
-    if (args.Length() >= 5 && !args[4]->IsUndefined() &&
-        !args[4]->IsNull() && !args[4]->IsObject()) {
-        RetThrowException(Exception::Error(NEW_STRING(
-            "Optional identity must be an object.")));
+
+    args.GetReturnValue().Set(scope.Escape(o));
+}
+
+// Send the specified `request` with the specified `cid`, taking the
+// optional identity, label and options from `args`, starting at the
+// specified `index`.  The caller handles BLPAPI exceptions.
+void
+Session::sendRequest(const FunctionCallbackInfo<Value>& args,
+                     const blpapi::Request&             request,
+                     const blpapi::CorrelationId&       cid,
+                     int                                index)
+{
+    const blpapi::Identity *identity = getIdentity(args, index);
+
+    if (args.Length() > index + 1 && args[index + 1]->IsString()) {
+        String::Utf8Value labelv(args[index + 1]->ToString());
+        d_session->sendRequest(request, *identity,
+                               cid, 0, *labelv, labelv.length());
+    } else {
+        d_session->sendRequest(request, *identity, cid);
     }
-    if (args.Length() >= 6 && !args[5]->IsUndefined() &&
-        !args[5]->IsNull() && !args[5]->IsString()) {
-        RetThrowException(Exception::Error(NEW_STRING(
-            "Optional request label must be a string.")));
+    retainCorrelation(cid);
+
+    if (args.Length() > index + 2 && args[index + 2]->IsObject() &&
+        args[index + 2]->ToObject()->Get(NEW_STRING("columnar"))
+                                                          ->BooleanValue()) {
+        d_columnar.insert(cid);
     }
-    if (args.Length() > 6) {
-        RetThrowException(Exception::Error(NEW_STRING(
-            "Function expects at most six arguments.")));
+}
+
+// Send the next chunks of the specified `cr` until `d_max_pending` of them
+// are outstanding.  A chunk that can not be sent counts as a failed chunk.
+void
+Session::sendChunks(ChunkedRequest *cr)
+{
+    while (cr->d_pending < cr->d_max_pending &&
+           cr->d_next < cr->d_requests.size()) {
+        std::size_t index = cr->d_next++;
+        try {
+            blpapi::CorrelationId cid = d_session->sendRequest(
+                                            *cr->d_requests[index],
+                                            cr->d_identity,
+                                            blpapi::CorrelationId(),
+                                            0,
+                                            cr->d_label.empty()
+                                                ? 0 : cr->d_label.c_str(),
+                                            static_cast<int>(
+                                                cr->d_label.length()));
+            d_chunks[cid] = std::make_pair(cr, index);
+            cr->d_sent[index] = uv_hrtime();
+            ++cr->d_pending;
+        } catch (const blpapi::Exception& e) {
+            cr->d_error = e.description();
+            ++cr->d_completed;
+            ++cr->d_failed;
+        }
+        delete cr->d_requests[index];
+        cr->d_requests[index] = 0;
     }
+}
 
-    int cidi = args[3]->Int32Value();
+// Account for a message of the specified event type `et` for the specified
+// `chunk`, sending further chunks once it completes, and return the event
+// type to report to Javascript: the final response or failure of every
+// chunk but the last to complete is reported as a partial response.  The
+// other messages of the event completing the chunk are reported the same
+// way, until `finishChunks` is called.  When the whole request completes,
+// load its statistics into the specified `stats`.
+blpapi::Event::EventType
+Session::completeChunk(Isolate                  *isolate,
+                       ChunkMap::iterator        chunk,
+                       blpapi::Event::EventType  et,
+                       Local<Object>            *stats)
+{
+    ChunkedRequest *cr = chunk->second.first;
+    ++cr->d_messages;
+    if (blpapi::Event::PARTIAL_RESPONSE == et) {
+        return et;
+    }
 
-    Session* session = ObjectWrap::Unwrap<Session>(args.This());
+    // Responses to reference data requests arrive in a single message, so
+    // the first `RESPONSE` or `REQUEST_STATUS` message completes the chunk.
+    uint64_t latency = uv_hrtime() - cr->d_sent[chunk->second.second];
+    if (0 == cr->d_min_latency || latency < cr->d_min_latency) {
+        cr->d_min_latency = latency;
+    }
+    if (latency > cr->d_max_latency) {
+        cr->d_max_latency = latency;
+    }
+    cr->d_total_latency += latency;
+    ++cr->d_timed;
+    --cr->d_pending;
+    ++cr->d_completed;
+    if (blpapi::Event::REQUEST_STATUS == et) {
+        ++cr->d_failed;
+    }
+    const blpapi::CorrelationId cid = chunk->first;
+    d_chunks.erase(chunk);
+
+    sendChunks(cr);
+    if (cr->d_pending || cr->d_next < cr->d_requests.size()) {
+        d_chunk_tails[cid] = std::make_pair(cr->d_cid,
+                                            blpapi::Event::PARTIAL_RESPONSE);
+        return blpapi::Event::PARTIAL_RESPONSE;
+    }
+    d_chunk_tails[cid] = std::make_pair(cr->d_cid, et);
+
+    const double elapsed = (uv_hrtime() - cr->d_start) / 1e6;
+    *stats = Object::New(isolate);
+#define SET_STAT(name, value)                                               \
+    (*stats)->Set(String::NewFromUtf8(isolate, name),                       \
+                  Number::New(isolate, value))
+    SET_STAT("chunks", cr->d_completed);
+    SET_STAT("failedChunks", cr->d_failed);
+    SET_STAT("securities", cr->d_securities);
+    SET_STAT("messages", cr->d_messages);
+    SET_STAT("elapsedMilliseconds", elapsed);
+    SET_STAT("securitiesPerSecond",
+             elapsed > 0 ? cr->d_securities * 1000.0 / elapsed : 0);
+    SET_STAT("minChunkMilliseconds", cr->d_min_latency / 1e6);
+    SET_STAT("maxChunkMilliseconds", cr->d_max_latency / 1e6);
+    SET_STAT("meanChunkMilliseconds",
+             cr->d_timed ? cr->d_total_latency / 1e6 / cr->d_timed : 0);
+#undef SET_STAT
+    delete cr;
+    return et;
+}
 
-    if (!session->d_session || session->d_destroy) {
-        RetThrowException(Exception::Error(NEW_STRING(
-            "Session has already been destroyed.")));
+// Release the requests whose last chunk completed with the event just
+// dispatched, once all of its messages were reported.
+void
+Session::finishChunks()
+{
+    for (ChunkTailMap::iterator it = d_chunk_tails.begin();
+         it != d_chunk_tails.end();
+         ++it) {
+        if (blpapi::Event::PARTIAL_RESPONSE != it->second.second) {
+            d_columnar.erase(it->second.first);
+            releaseCorrelation(it->second.first);
+        }
     }
+    d_chunk_tails.clear();
+}
 
-    BLPAPI_EXCEPTION_TRY
+// Forget every chunked request still in progress.
+void
+Session::clearChunks()
+{
+    std::set<ChunkedRequest *> requests;
+    for (ChunkMap::iterator it = d_chunks.begin();
+         it != d_chunks.end();
+         ++it) {
+        requests.insert(it->second.first);
+    }
+    for (std::set<ChunkedRequest *>::iterator it = requests.begin();
+         it != requests.end();
+         ++it) {
+        delete *it;
+    }
+    d_chunks.clear();
+    d_chunk_tails.clear();
+}
 
-    Local<String> uri = args[0]->ToString();
-    String::Utf8Value uriv(uri);
+// Send the authorization request of the specified `auth` if the specified
+// token status `msg` holds a token, and reject it otherwise.
+void
+Session::requestAuthorization(Isolate                 *isolate,
+                              PendingAuthorization    *auth,
+                              const blpapi::Message&   msg)
+{
+    static const blpapi::Name TOKEN_GENERATION_SUCCESS(
+                                                     "TokenGenerationSuccess");
+    static const blpapi::Name TOKEN("token");
+    static const blpapi::Name REASON("reason");
 
-    blpapi::Service service = session->d_session->getService(*uriv);
+    std::string error;
+    try {
+        if (TOKEN_GENERATION_SUCCESS == msg.messageType()) {
+            blpapi::Service authService =
+                                 d_session->getService(auth->d_uri.c_str());
+            blpapi::Request authRequest =
+                authService.createAuthorizationRequest("AuthorizationRequest");
+            authRequest.set("token", msg.getElementAsString(TOKEN));
+
+            d_identity = d_session->createIdentity();
+            d_session->sendAuthorizationRequest(authRequest,
+                                                &d_identity,
+                                                auth->d_cid);
+            d_authorizations[auth->d_cid] = auth;
+            return;
+        }
+        std::stringstream ss;
+        ss << "Failed to generate token: " << msg.getElement(REASON);
+        error = ss.str();
+    } catch (const blpapi::Exception& e) {
+        error = e.description();
+    }
+    settleAuthorization(isolate,
+                        auth,
+                        false,
+                        Exception::Error(String::NewFromUtf8(isolate,
+                                                             error.c_str())));
+}
 
-    Local<String> name = args[1]->ToString();
-    String::Utf8Value namev(name);
+// Resolve the promise of the specified `auth` with the specified `value`
+// if `success`, and reject it otherwise, then destroy `auth`.
+void
+Session::settleAuthorization(Isolate               *isolate,
+                             PendingAuthorization  *auth,
+                             bool                   success,
+                             Handle<Value>          value)
+{
+    Local<Promise::Resolver> resolver =
+        Local<Promise::Resolver>::New(isolate, auth->d_resolver);
+    if (success) {
+        resolver->Resolve(value);
+    } else {
+        resolver->Reject(value);
+    }
+    releaseCorrelation(auth->d_cid);
+    delete auth;
+}
 
-    blpapi::Request request(service.createRequest(*namev));
-    std::string error;
-    if (loadRequest(&request, args[2], &error)) {
-        RetThrowException(Exception::Error(NEW_STRING(error.c_str())));
+// Send the queued authorization requests of the specified `bulk` until
+// `d_max_pending` of them are outstanding, and resolve its promise once
+// every user has a result.
+void
+Session::sendUserAuthorizations(Isolate *isolate, BulkAuthorization *bulk)
+{
+    while (bulk->d_pending < bulk->d_max_pending &&
+           bulk->d_next < bulk->d_queue.size()) {
+        std::size_t index = bulk->d_queue[bulk->d_next++];
+        try {
+            bulk->d_identities[index] = d_session->createIdentity();
+            blpapi::CorrelationId cid = d_session->sendAuthorizationRequest(
+                                                *bulk->d_requests[index],
+                                                &bulk->d_identities[index]);
+            d_user_authorizations[cid] = std::make_pair(bulk, index);
+            ++bulk->d_pending;
+        } catch (const blpapi::Exception& e) {
+            setUserAuthorization(isolate,
+                                 bulk,
+                                 index,
+                                 Handle<Value>(),
+                                 false,
+                                 Exception::Error(String::NewFromUtf8(
+                                          isolate, e.description().c_str())));
+        }
+        delete bulk->d_requests[index];
+        bulk->d_requests[index] = 0;
     }
 
-    blpapi::CorrelationId cid(cidi);
+    if (0 == bulk->d_remaining) {
+        Local<Promise::Resolver>::New(isolate, bulk->d_resolver)->Resolve(
+                             Local<Array>::New(isolate, bulk->d_results));
+        delete bulk;
+    }
+}
 
-    const blpapi::Identity *identity = session->getIdentity(args, 4);
+// Set the result of the user at the specified `index` of the specified
+// `bulk` to the specified `identity`, which is flagged as `cached` or not,
+// or to the specified `error` if `identity` is empty.
+void
+Session::setUserAuthorization(Isolate            *isolate,
+                              BulkAuthorization  *bulk,
+                              std::size_t         index,
+                              Handle<Value>       identity,
+                              bool                cached,
+                              Handle<Value>       error)
+{
+    Local<Object> result = Object::New(isolate);
+    result->Set(Local<String>::New(isolate, s_key),
+                String::NewFromUtf8(isolate, bulk->d_keys[index].c_str()));
+    if (identity.IsEmpty()) {
+        result->Set(Local<String>::New(isolate, s_error), error);
+    } else {
+        result->Set(Local<String>::New(isolate, s_identity), identity);
+        result->Set(Local<String>::New(isolate, s_cached),
+                    Boolean::New(isolate, cached));
+    }
+    Local<Array>::New(isolate, bulk->d_results)->Set(index, result);
+    --bulk->d_remaining;
+}
 
-    if (args.Length() == 6) {
-        String::Utf8Value labelv(args[5]->ToString());
-        session->d_session->sendRequest(request, *identity,
-                                        cid, 0, *labelv, labelv.length());
+// Record the result of the authorization request of the specified `it`
+// from the specified response `msg`, caching the identity if `success`,
+// and send the next queued requests of its `authorizeUsers` call.
+void
+Session::completeUserAuthorization(Isolate                        *isolate,
+                                   UserAuthorizationMap::iterator  it,
+                                   const blpapi::Message&          msg,
+                                   bool                            success)
+{
+    BulkAuthorization *bulk = it->second.first;
+    std::size_t index = it->second.second;
+    blpapi::CorrelationId cid = it->first;
+    d_user_authorizations.erase(it);
+    --bulk->d_pending;
+
+    if (success) {
+        const std::string& key = bulk->d_keys[index];
+        CachedIdentity& cached = d_identity_cache[key];
+        d_cached_cids.erase(cached.d_cid);
+        cached.d_identity = bulk->d_identities[index];
+        cached.d_cid = cid;
+        cached.d_expiry = bulk->d_ttl > 0
+            ? uv_hrtime() + static_cast<uint64_t>(bulk->d_ttl * 1e6) : 0;
+        d_cached_cids[cid] = key;
+
+        setUserAuthorization(isolate,
+                             bulk,
+                             index,
+                             Identity::New(isolate, cached.d_identity),
+                             false,
+                             Handle<Value>());
     } else {
-        session->d_session->sendRequest(request, *identity, cid);
+        Local<Object> error = Exception::Error(String::NewFromUtf8(
+                              isolate, "Authorization failed."))->ToObject();
+        error->Set(Local<String>::New(isolate, s_data),
+                   elementToValue(isolate, msg.asElement()));
+        setUserAuthorization(isolate,
+                             bulk,
+                             index,
+                             Handle<Value>(),
+                             false,
+                             error);
     }
 
-    BLPAPI_EXCEPTION_CATCH_RETURN
+    sendUserAuthorizations(isolate, bulk);
+}
+
+// Forget every `authorizeUsers` still in progress, rejecting their promises
+// if the specified `reject` is set, along with every cached identity.
+void
+Session::clearUserAuthorizations(bool reject)
+{
+    std::set<BulkAuthorization *> bulks;
+    for (UserAuthorizationMap::iterator it = d_user_authorizations.begin();
+         it != d_user_authorizations.end();
+         ++it) {
+        bulks.insert(it->second.first);
+    }
+    for (std::set<BulkAuthorization *>::iterator it = bulks.begin();
+         it != bulks.end();
+         ++it) {
+        if (reject) {
+            HandleScope scope(d_isolate);
+            Local<Promise::Resolver>::New(d_isolate, (*it)->d_resolver)
+                ->Reject(Exception::Error(String::NewFromUtf8(
+                                    d_isolate,
+                                    "Session has already been destroyed.")));
+        }
+        delete *it;
+    }
+    d_user_authorizations.clear();
+    d_identity_cache.clear();
+    d_cached_cids.clear();
+}
 
-    args.GetReturnValue().Set(
-        scope.Escape(Integer::New(args.GetIsolate(), cidi)));
+// Forget every `authorize` still in progress, rejecting their promises if
+// the specified `reject` is set.
+void
+Session::clearAuthorizations(bool reject)
+{
+    for (AuthorizationMap::iterator it = d_authorizations.begin();
+         it != d_authorizations.end();
+         ++it) {
+        if (reject) {
+            HandleScope scope(d_isolate);
+            settleAuthorization(d_isolate,
+                                it->second,
+                                false,
+                                Exception::Error(String::NewFromUtf8(
+                                    d_isolate,
+                                    "Session has already been destroyed.")));
+        } else {
+            delete it->second;
+        }
+    }
+    d_authorizations.clear();
 }
 
 Handle<Value>
@@ -1036,11 +4034,8 @@ Session::elementToValue(Isolate *isolate, const blpapi::Element& e)
             } else {
                 sev = elementValueToValue(isolate, se);
             }
-            o->ForceSet(String::NewFromUtf8(isolate,
-                                            se.name().string(),
-                                            String::kNormalString,
-                                            se.name().length()),
-                   sev, (PropertyAttribute)(ReadOnly | DontDelete));
+            o->ForceSet(internName(isolate, se.name()),
+                        sev, (PropertyAttribute)(ReadOnly | DontDelete));
         }
         return o;
     } else if (e.isArray()) {
@@ -1055,50 +4050,467 @@ Session::elementToValue(Isolate *isolate, const blpapi::Element& e)
     }
 }
 
-static inline struct tm*
-mknow(struct tm* tm)
+// Convert the specified top-level element `e` of a message of the specified
+// `messageType`.  If data templates are enabled, the names of the elements
+// of the first message of each type are remembered, and the `data` of later
+// messages with exactly the same elements is created from a template, so
+// that they all share one hidden class.
+Handle<Value>
+Session::dataToValue(Isolate                *isolate,
+                     const blpapi::Name&     messageType,
+                     const blpapi::Element&  e)
 {
-    time_t sec;
-    time(&sec);
-#ifdef _WIN32
-    gmtime_s(tm, &sec);
-    return tm;
-#else
-    return gmtime_r(&sec, tm);
-#endif
+    if (!d_use_data_templates || !e.isComplexType()) {
+        return elementToValue(isolate, e);
+    }
+
+    const std::size_t numElements = e.numElements();
+    DataTemplate *dt;
+    std::map<blpapi_Name_t *, DataTemplate *>::iterator it =
+        d_data_templates.find(messageType.impl());
+    if (it != d_data_templates.end()) {
+        dt = it->second;
+    } else {
+        Local<ObjectTemplate> t = ObjectTemplate::New(isolate);
+        dt = new DataTemplate;
+        for (std::size_t i = 0; i < numElements; ++i) {
+            blpapi::Name name = e.getElement(i).name();
+            dt->d_names.push_back(name);
+            t->Set(internName(isolate, name),
+                   Undefined(isolate),
+                   (PropertyAttribute)(ReadOnly | DontDelete));
+        }
+        dt->d_template.Reset(isolate, t);
+        d_data_templates[messageType.impl()] = dt;
+    }
+
+    if (dt->d_names.size() != numElements) {
+        return elementToValue(isolate, e);
+    }
+    Local<Object> o =
+        Local<ObjectTemplate>::New(isolate, dt->d_template)->NewInstance();
+    for (std::size_t i = 0; i < numElements; ++i) {
+        blpapi::Element se = e.getElement(i);
+        if (!(se.name() == dt->d_names[i])) {
+            // A different shape; `o` is simply discarded.
+            return elementToValue(isolate, e);
+        }
+        Handle<Value> sev;
+        if (se.isComplexType() || se.isArray()) {
+            sev = elementToValue(isolate, se);
+        } else {
+            sev = elementValueToValue(isolate, se);
+        }
+        o->ForceSet(internName(isolate, se.name()),
+                    sev, (PropertyAttribute)(ReadOnly | DontDelete));
+    }
+    return o;
+}
+
+// Convert the top-level elements of the specified `msg` together with
+// those of the specified `older` updates for the same subscription that
+// `msg` does not contain, so that each field holds its latest value.  Only
+// the elements named in the optional `names` are converted.
+Handle<Value>
+Session::mergeElements(Isolate                             *isolate,
+                       const blpapi::Message&               msg,
+                       const std::vector<blpapi::Message>&  older,
+                       const std::vector<blpapi::Name>     *names)
+{
+    Local<Object> o = Object::New(isolate);
+    std::set<blpapi_Name_t *> wanted;
+    if (names) {
+        for (std::size_t i = 0; i < names->size(); ++i) {
+            wanted.insert((*names)[i].impl());
+        }
+    }
+
+    // Visit the updates from the latest to the oldest.
+    std::set<blpapi_Name_t *> seen;
+    for (std::size_t n = 0; n <= older.size(); ++n) {
+        blpapi::Element e = (n ? older[older.size() - n] : msg).asElement();
+        for (std::size_t i = 0; i < e.numElements(); ++i) {
+            blpapi::Element se = e.getElement(i);
+            blpapi_Name_t *name = se.name().impl();
+            if ((names && !wanted.count(name)) ||
+                !seen.insert(name).second) {
+                continue;
+            }
+            Handle<Value> sev;
+            if (se.isComplexType() || se.isArray()) {
+                sev = elementToValue(isolate, se);
+            } else {
+                sev = elementValueToValue(isolate, se);
+            }
+            o->ForceSet(internName(isolate, se.name()),
+                        sev, (PropertyAttribute)(ReadOnly | DontDelete));
+        }
+    }
+    return o;
 }
 
-static inline time_t
-mkutctime(struct tm* tm)
+// Convert only the sub-elements of the specified complex element `e` that
+// are named in the specified `names`, in that order.  Names `e` does not
+// contain are skipped.
+Handle<Value>
+Session::projectElement(Isolate                         *isolate,
+                        const blpapi::Element&           e,
+                        const std::vector<blpapi::Name>& names)
 {
-    time_t ret;
+    Local<Object> o = Object::New(isolate);
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        blpapi::Element se;
+        if (0 != e.getElement(&se, names[i])) {
+            continue;
+        }
+        Handle<Value> sev;
+        if (se.isComplexType() || se.isArray()) {
+            sev = elementToValue(isolate, se);
+        } else {
+            sev = elementValueToValue(isolate, se);
+        }
+        o->ForceSet(internName(isolate, se.name()),
+                    sev, (PropertyAttribute)(ReadOnly | DontDelete));
+    }
+    return o;
+}
 
-#ifdef _WIN32
-    char tz[128];
-    std::size_t len = 0;
-    getenv_s(&len, tz, sizeof(tz), "TZ");
-    _putenv_s("TZ", "UTC");
-    _tzset();
-#else
-    char* tz = getenv("TZ");
-    setenv("TZ", "UTC", 1);
-    tzset();
-#endif
+// Return the number of days between 1970-01-01 and the specified date in
+// the proleptic Gregorian calendar.  This is the `days_from_civil`
+// algorithm by Howard Hinnant, which needs no table lookups or calls into
+// the C library's time zone machinery.
+static inline int
+mkdays(int year, unsigned int month, unsigned int day)
+{
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned int yoe = static_cast<unsigned int>(year - era * 400);
+    const unsigned int doy = (153 * (month > 2 ? month - 3 : month + 9) + 2)
+                                                                / 5 + day - 1;
+    const unsigned int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int>(doe) - 719468;
+}
 
-    ret = mktime(tm);
+// Return the number of days between 1970-01-01 and the current UTC date.
+static inline int
+mktoday()
+{
+    // The day only changes once every 86400 seconds, so remember when the
+    // current one ends rather than dividing on every call.
+    static time_t s_tomorrow = 0;
+    static int s_today = 0;
+
+    time_t sec = time(NULL);
+    if (sec >= s_tomorrow || sec < s_tomorrow - 86400) {
+        s_today = static_cast<int>(sec / 86400 - (sec % 86400 < 0));
+        s_tomorrow = static_cast<time_t>(s_today + 1) * 86400;
+    }
+    return s_today;
+}
 
-#ifdef _WIN32
-    _putenv_s("TZ", len ? tz : "");
-    _tzset();
-#else
-    if (tz)
-        setenv("TZ", tz, 1);
-    else
-        unsetenv("TZ");
-    tzset();
-#endif
+// Load into the specified `ms` the milliseconds since the epoch for the
+// specified `dt` of the specified DATE, TIME or DATETIME `datatype`, and
+// return `true`, or return `false` if `dt` lacks the parts the `datatype`
+// requires.  A missing date is taken to be today (UTC), and a missing
+// time to be midnight.
+static inline bool
+mkepochms(int datatype, const blpapi::Datetime& dt, double *ms)
+{
+    const bool hasDate = dt.hasParts(blpapi::DatetimeParts::DATE);
+    const bool hasTime = dt.hasParts(blpapi::DatetimeParts::TIME);
+
+    if (blpapi::DataType::DATE == datatype) {
+        if (!hasDate)
+            return false;
+        *ms = mkdays(dt.year(), dt.month(), dt.day()) * 86400000.0;
+        return true;
+    }
+    if (blpapi::DataType::TIME == datatype && !hasTime) {
+        return false;
+    }
+
+    // Use date if present, otherwise default to "now".
+    double sec = (hasDate && blpapi::DataType::TIME != datatype
+                  ? mkdays(dt.year(), dt.month(), dt.day())
+                  : mktoday()) * 86400.0;
+    // Use time if present, otherwise default to midnight.
+    if (hasTime) {
+        sec += dt.hours() * 3600 + dt.minutes() * 60 + dt.seconds();
+    }
+    if (dt.hasParts(blpapi::DatetimeParts::OFFSET)) {
+        sec -= dt.offset() * 60;  // UTC offset (in minutes)
+    }
+    *ms = sec * 1000.0;
+    if (dt.hasParts(blpapi::DatetimeParts::FRACSECONDS))
+        *ms += dt.milliSeconds();
+    return true;
+}
+
+// Create a `Float64Array` of the specified `length`, and load into the
+// specified `data` the address of its elements.
+static inline Local<Object>
+mkfloat64array(Isolate *isolate, std::size_t length, double **data)
+{
+    Local<ArrayBuffer> buffer =
+        ArrayBuffer::New(isolate, length * sizeof(double));
+    Local<Float64Array> array = Float64Array::New(buffer, 0, length);
+    *data = static_cast<double *>(
+                               array->GetIndexedPropertiesExternalArrayData());
+    return array;
+}
+
+// Create an `Int32Array` of the specified `length`, and load into the
+// specified `data` the address of its elements.
+static inline Local<Object>
+mkint32array(Isolate *isolate, std::size_t length, int32_t **data)
+{
+    Local<ArrayBuffer> buffer =
+        ArrayBuffer::New(isolate, length * sizeof(int32_t));
+    Local<Int32Array> array = Int32Array::New(buffer, 0, length);
+    *data = static_cast<int32_t *>(
+                               array->GetIndexedPropertiesExternalArrayData());
+    return array;
+}
+
+// Convert the specified element `e` of a response like `elementToValue`,
+// except that the rows of historical data, intraday bars and intraday ticks
+// are converted column by column.
+Handle<Value>
+Session::columnarElementToValue(Isolate *isolate, const blpapi::Element& e)
+{
+    static const blpapi::Name FIELD_DATA("fieldData");        // historical
+    static const blpapi::Name BAR_TICK_DATA("barTickData");   // bars
+    static const blpapi::Name TICK_DATA("tickData");          // ticks
+
+    if (e.isArray()) {
+        if (blpapi::DataType::SEQUENCE == e.datatype() &&
+            (FIELD_DATA == e.name() ||
+             BAR_TICK_DATA == e.name() ||
+             TICK_DATA == e.name())) {
+            return columnsToValue(isolate, e);
+        }
+        return elementToValue(isolate, e);
+    }
+    if (!e.isComplexType()) {
+        return elementValueToValue(isolate, e);
+    }
+
+    int numElements = e.numElements();
+    Local<Object> o = Object::New(isolate);
+    for (int i = 0; i < numElements; ++i) {
+        blpapi::Element se = e.getElement(i);
+        Handle<Value> sev;
+        if (se.isComplexType() || se.isArray()) {
+            sev = columnarElementToValue(isolate, se);
+        } else {
+            sev = elementValueToValue(isolate, se);
+        }
+        o->ForceSet(internName(isolate, se.name()),
+                    sev, (PropertyAttribute)(ReadOnly | DontDelete));
+    }
+    return o;
+}
+
+namespace {
+
+// A column of `Session::columnsToValue`.
+struct Column {
+    enum Kind {
+        NUMBER,    // all values convert to `double`
+        DATETIME,  // all values are dates and/or times of `d_datatype`
+        STRING,    // all values are strings or enumerations
+        OTHER      // anything else, or values of different kinds
+    };
+
+    blpapi::Name                d_name;
+    Kind                        d_kind;
+    int                         d_datatype;  // 0 while only nulls are seen
+    double                     *d_values;
+    int32_t                    *d_codes;
+    std::map<std::string, int>  d_dictionary;
+    Local<Array>                d_words;
+    Local<Object>               d_array;
+
+    Column(const blpapi::Name& name, Kind kind, int datatype)
+    : d_name(name)
+    , d_kind(kind)
+    , d_datatype(datatype)
+    , d_values(0)
+    , d_codes(0)
+    {
+    }
+};
+
+Column::Kind
+columnKind(const blpapi::Element& e)
+{
+    switch (e.datatype()) {
+        case blpapi::DataType::BYTE:
+        case blpapi::DataType::INT32:
+        case blpapi::DataType::INT64:
+        case blpapi::DataType::FLOAT32:
+        case blpapi::DataType::FLOAT64:
+            return e.isArray() ? Column::OTHER : Column::NUMBER;
+        case blpapi::DataType::DATE:
+        case blpapi::DataType::TIME:
+        case blpapi::DataType::DATETIME:
+            return e.isArray() ? Column::OTHER : Column::DATETIME;
+        case blpapi::DataType::STRING:
+        case blpapi::DataType::ENUMERATION:
+            return e.isArray() ? Column::OTHER : Column::STRING;
+        default:
+            return Column::OTHER;
+    }
+}
+
+// Return the index in the specified `columns` of the column named by the
+// specified `name`, trying the specified `hint` first, or `-1` if there is
+// none.
+int
+findColumn(const std::vector<Column>&              columns,
+           const std::map<blpapi_Name_t *, int>&   index,
+           const blpapi::Name&                     name,
+           std::size_t                             hint)
+{
+    if (hint < columns.size() && columns[hint].d_name == name) {
+        return static_cast<int>(hint);
+    }
+    std::map<blpapi_Name_t *, int>::const_iterator it =
+        index.find(name.impl());
+    return it == index.end() ? -1 : it->second;
+}
+
+}  // close anonymous namespace
+
+// Convert the specified array of sequences `rows` into an object with one
+// property per distinct sub-element name.  Numeric columns become
+// `Float64Array`s, date and time columns `Float64Array`s of milliseconds
+// since the epoch, and missing or null values `NaN`.  String columns are
+// dictionary encoded as `{ codes, values }`, where `codes` is an
+// `Int32Array` of indices into the array of distinct strings `values`, or
+// `-1` for missing values.  Other columns become arrays of converted values.
+Handle<Value>
+Session::columnsToValue(Isolate *isolate, const blpapi::Element& rows)
+{
+    const std::size_t numRows = rows.numValues();
+    std::vector<Column> columns;
+    std::map<blpapi_Name_t *, int> index;
+
+    // Find the columns and the kind of their values.
+    for (std::size_t r = 0; r < numRows; ++r) {
+        blpapi::Element row = rows.getValueAsElement(r);
+        const std::size_t numElements = row.numElements();
+        for (std::size_t i = 0; i < numElements; ++i) {
+            blpapi::Element e = row.getElement(i);
+            blpapi::Name name = e.name();
+            int c = findColumn(columns, index, name, i);
+            if (e.isNull()) {
+                if (c < 0) {
+                    index[name.impl()] = static_cast<int>(columns.size());
+                    columns.push_back(Column(name, Column::NUMBER, 0));
+                }
+                continue;
+            }
+            Column::Kind kind = columnKind(e);
+            if (c < 0) {
+                index[name.impl()] = static_cast<int>(columns.size());
+                columns.push_back(Column(name, kind, e.datatype()));
+            } else if (columns[c].d_kind != kind ||
+                       (Column::DATETIME == kind &&
+                        columns[c].d_datatype != e.datatype())) {
+                // Columns of nulls so far take the kind of their first
+                // value.
+                if (0 == columns[c].d_datatype) {
+                    columns[c].d_kind = kind;
+                    columns[c].d_datatype = e.datatype();
+                } else {
+                    columns[c].d_kind = Column::OTHER;
+                }
+            } else if (0 == columns[c].d_datatype) {
+                columns[c].d_datatype = e.datatype();
+            }
+        }
+    }
+
+    // Allocate the columns, with every value missing.
+    for (std::size_t c = 0; c < columns.size(); ++c) {
+        Column& column = columns[c];
+        if (Column::OTHER == column.d_kind) {
+            Local<Array> array = Array::New(isolate, numRows);
+            for (std::size_t r = 0; r < numRows; ++r) {
+                array->Set(r, Null(isolate));
+            }
+            column.d_array = array;
+        } else if (Column::STRING == column.d_kind) {
+            Local<Object> o = Object::New(isolate);
+            o->Set(Local<String>::New(isolate, s_codes),
+                   mkint32array(isolate, numRows, &column.d_codes));
+            std::fill(column.d_codes, column.d_codes + numRows, -1);
+            column.d_words = Array::New(isolate);
+            o->Set(Local<String>::New(isolate, s_values), column.d_words);
+            column.d_array = o;
+        } else {
+            column.d_array =
+                mkfloat64array(isolate, numRows, &column.d_values);
+            std::fill(column.d_values,
+                      column.d_values + numRows,
+                      std::numeric_limits<double>::quiet_NaN());
+        }
+    }
+
+    // Fill in the values.
+    for (std::size_t r = 0; r < numRows; ++r) {
+        blpapi::Element row = rows.getValueAsElement(r);
+        const std::size_t numElements = row.numElements();
+        for (std::size_t i = 0; i < numElements; ++i) {
+            blpapi::Element e = row.getElement(i);
+            if (e.isNull()) {
+                continue;
+            }
+            Column& column = columns[findColumn(columns, index, e.name(), i)];
+            switch (column.d_kind) {
+                case Column::NUMBER:
+                    column.d_values[r] = e.getValueAsFloat64();
+                    break;
+                case Column::DATETIME: {
+                    double ms;
+                    if (mkepochms(column.d_datatype,
+                                  e.getValueAsDatetime(),
+                                  &ms)) {
+                        column.d_values[r] = ms;
+                    }
+                } break;
+                case Column::STRING: {
+                    const int next =
+                        static_cast<int>(column.d_dictionary.size());
+                    std::pair<std::map<std::string, int>::iterator, bool> w =
+                        column.d_dictionary.insert(std::make_pair(
+                                    std::string(e.getValueAsString()), next));
+                    if (w.second) {
+                        column.d_words->Set(w.first->second,
+                                            String::NewFromUtf8(
+                                                isolate,
+                                                w.first->first.c_str()));
+                    }
+                    column.d_codes[r] = w.first->second;
+                } break;
+                default:
+                    column.d_array->Set(r,
+                                        e.isComplexType() || e.isArray()
+                                        ? elementToValue(isolate, e)
+                                        : elementValueToValue(isolate, e));
+                    break;
+            }
+        }
+    }
 
-    return ret;
+    Local<Object> o = Object::New(isolate);
+    for (std::size_t c = 0; c < columns.size(); ++c) {
+        o->ForceSet(internName(isolate, columns[c].d_name),
+                    columns[c].d_array,
+                    (PropertyAttribute)(ReadOnly | DontDelete));
+    }
+    return o;
 }
 
 Handle<Value>
@@ -1123,13 +4535,8 @@ Session::elementValueToValue(Isolate                *isolate,
             return Number::New(isolate, e.getValueAsFloat32(idx));
         case blpapi::DataType::FLOAT64:
             return Number::New(isolate, e.getValueAsFloat64(idx));
-        case blpapi::DataType::ENUMERATION: {
-            blpapi::Name n = e.getValueAsName(idx);
-            return String::NewFromUtf8(isolate,
-                                       n.string(),
-                                       String::kNormalString,
-                                       n.length());
-        }
+        case blpapi::DataType::ENUMERATION:
+            return internName(isolate, e.getValueAsName(idx));
         case blpapi::DataType::INT64: {
             // IEEE754 double can represent the range [-2^53, 2^53].
             static const blpapi::Int64 MAX_DOUBLE_INT = 9007199254740992LL;
@@ -1140,89 +4547,140 @@ Session::elementValueToValue(Isolate                *isolate,
         }
         case blpapi::DataType::STRING:
             return String::NewFromUtf8(isolate, e.getValueAsString(idx));
-        case blpapi::DataType::DATE: {
-            blpapi::Datetime dt = e.getValueAsDatetime(idx);
-            if (dt.hasParts(blpapi::DatetimeParts::DATE)) {
-                struct tm date;
-                date.tm_sec = 0;
-                date.tm_min = 0;
-                date.tm_hour = 0;
-                date.tm_mday = dt.day();
-                date.tm_mon = dt.month() - 1;
-                date.tm_year = dt.year() - 1900;
-                date.tm_wday = 0;
-                date.tm_yday = 0;
-                date.tm_isdst = 0;
-                time_t sec = mkutctime(&date);
-                double ms = sec * 1000.0L;
+        case blpapi::DataType::DATE:
+        case blpapi::DataType::TIME:
+        case blpapi::DataType::DATETIME: {
+            double ms;
+            if (mkepochms(e.datatype(), e.getValueAsDatetime(idx), &ms))
                 return Date::New(isolate, ms);
-            }
             break;
         }
-        case blpapi::DataType::TIME: {
-            blpapi::Datetime dt = e.getValueAsDatetime(idx);
-            if (dt.hasParts(blpapi::DatetimeParts::TIME)) {
-                struct tm date;
-                mknow(&date);
-                date.tm_sec = dt.seconds();
-                date.tm_min = dt.minutes();
-                date.tm_hour = dt.hours();
-                date.tm_isdst = 0;
-                time_t sec = mkutctime(&date);
-                if (dt.hasParts(blpapi::DatetimeParts::OFFSET)) {
-                    sec -= dt.offset() * 60;  // UTC offset (in minutes)
-                }
-                double ms = sec * 1000.0L;
-                if (dt.hasParts(blpapi::DatetimeParts::FRACSECONDS))
-                    ms += dt.milliSeconds();
-                return Date::New(isolate, ms);
-            }
+        case blpapi::DataType::SEQUENCE:
+        case blpapi::DataType::CHOICE:
+            return elementToValue(isolate, e.getValueAsElement(idx));
+        default:
             break;
+    }
+
+    return Null(isolate);
+}
+
+// Store the value of each scalar top-level field of the specified
+// subscription data `msg` as the last value of that field for its
+// subscription, unless it is no longer subscribed.  Each field name is
+// given an index, shared by all subscriptions, into the array of values of
+// a subscription.
+void
+Session::cacheLastValues(const blpapi::Message& msg)
+{
+    LastValueMap::iterator it = d_last_values.find(msg.correlationId(0));
+    if (it == d_last_values.end()) {
+        return;
+    }
+    std::vector<FieldValue>& values = it->second;
+    blpapi::Element e = msg.asElement();
+    const std::size_t numElements = e.numElements();
+    for (std::size_t i = 0; i < numElements; ++i) {
+        blpapi::Element se = e.getElement(i);
+        if (se.isComplexType() || se.isArray()) {
+            continue;
+        }
+
+        blpapi::Name name = se.name();
+        std::map<blpapi_Name_t *, std::size_t>::iterator f =
+                                          d_field_indices.find(name.impl());
+        if (f == d_field_indices.end()) {
+            f = d_field_indices.insert(std::make_pair(name.impl(),
+                                             d_field_names.size())).first;
+            d_field_names.push_back(name);
+        }
+        if (f->second >= values.size()) {
+            values.resize(f->second + 1);
         }
-        case blpapi::DataType::DATETIME: {
-            blpapi::Datetime dt = e.getValueAsDatetime(idx);
-            struct tm date;
-            // Use date if present, otherwise default to "now".
-            if (dt.hasParts(blpapi::DatetimeParts::DATE)) {
-                date.tm_mday = dt.day();
-                date.tm_mon = dt.month() - 1;
-                date.tm_year = dt.year() - 1900;
-                date.tm_wday = 0;
-                date.tm_yday = 0;
-            } else {
-                mknow(&date);
-            }
-            // Use time if present, otherwise default to midnight.
-            if (dt.hasParts(blpapi::DatetimeParts::TIME)) {
-                date.tm_sec = dt.seconds();
-                date.tm_min = dt.minutes();
-                date.tm_hour = dt.hours();
-                date.tm_isdst = 0;
-            } else {
-                date.tm_sec = 0;
-                date.tm_min = 0;
-                date.tm_hour = 0;
-                date.tm_isdst = 0;
-            }
-            time_t sec = mkutctime(&date);
-            if (dt.hasParts(blpapi::DatetimeParts::OFFSET)) {
-                sec -= dt.offset() * 60;  // UTC offset (in minutes)
+
+        FieldValue& v = values[f->second];
+        v.d_type = FieldValue::NULL_VALUE;
+        if (se.isNull()) {
+            continue;
+        }
+        try {
+            switch (se.datatype()) {
+              case blpapi::DataType::BOOL:
+                v.d_type = FieldValue::BOOLEAN;
+                v.d_number = se.getValueAsBool() ? 1 : 0;
+                break;
+              case blpapi::DataType::BYTE:
+              case blpapi::DataType::INT32:
+                v.d_type = FieldValue::NUMBER;
+                v.d_number = se.getValueAsInt32();
+                break;
+              case blpapi::DataType::INT64: {
+                static const blpapi::Int64 MAX_DOUBLE_INT =
+                                                        9007199254740992LL;
+                blpapi::Int64 n = se.getValueAsInt64();
+                if (n >= -MAX_DOUBLE_INT && n <= MAX_DOUBLE_INT) {
+                    v.d_type = FieldValue::NUMBER;
+                    v.d_number = static_cast<double>(n);
+                }
+              } break;
+              case blpapi::DataType::FLOAT32:
+                v.d_type = FieldValue::NUMBER;
+                v.d_number = se.getValueAsFloat32();
+                break;
+              case blpapi::DataType::FLOAT64:
+                v.d_type = FieldValue::NUMBER;
+                v.d_number = se.getValueAsFloat64();
+                break;
+              case blpapi::DataType::CHAR:
+                v.d_type = FieldValue::STRING;
+                v.d_string.assign(1, se.getValueAsChar());
+                break;
+              case blpapi::DataType::STRING:
+                v.d_type = FieldValue::STRING;
+                v.d_string = se.getValueAsString();
+                break;
+              case blpapi::DataType::ENUMERATION:
+                v.d_type = FieldValue::STRING;
+                v.d_string = se.getValueAsName().string();
+                break;
+              case blpapi::DataType::DATE:
+              case blpapi::DataType::TIME:
+              case blpapi::DataType::DATETIME:
+                if (mkepochms(se.datatype(),
+                              se.getValueAsDatetime(),
+                              &v.d_number)) {
+                    v.d_type = FieldValue::DATE;
+                }
+                break;
+              default:
+                break;
             }
-            double ms = sec * 1000.0L;
-            if (dt.hasParts(blpapi::DatetimeParts::FRACSECONDS))
-                ms += dt.milliSeconds();
-            return Date::New(isolate, ms);
+        } catch (const blpapi::Exception&) {
+            v.d_type = FieldValue::NULL_VALUE;
         }
-        case blpapi::DataType::SEQUENCE:
-        case blpapi::DataType::CHOICE:
-            return elementToValue(isolate, e.getValueAsElement(idx));
-        default:
-            break;
     }
-
-    return Null(isolate);
 }
 
+// Convert the specified cached field value `v`.
+Local<Value>
+Session::fieldValueToValue(Isolate *isolate, const FieldValue& v)
+{
+    switch (v.d_type) {
+      case FieldValue::BOOLEAN:
+        return Boolean::New(isolate, 0 != v.d_number);
+      case FieldValue::NUMBER:
+        return Number::New(isolate, v.d_number);
+      case FieldValue::STRING:
+        return String::NewFromUtf8(isolate,
+                                   v.d_string.data(),
+                                   String::kNormalString,
+                                   static_cast<int>(v.d_string.size()));
+      case FieldValue::DATE:
+        return Date::New(isolate, v.d_number);
+      default:
+        return Null(isolate);
+    }
+}
 
 const blpapi::Identity*
 Session::getIdentity(const FunctionCallbackInfo<Value>& args, int index)
@@ -1238,8 +4696,9 @@ Session::getIdentity(const FunctionCallbackInfo<Value>& args, int index)
     return identity;
 }
 
-#define EVENT_TO_STRING(e) \
-    case blpapi::Event::e : return String::NewFromUtf8(isolate, #e)
+#define EVENT_TO_STRING(e)                                                  \
+    case blpapi::Event::e :                                                 \
+        return String::NewFromUtf8(isolate, #e, String::kInternalizedString)
 
 static inline Handle<Value>
 eventTypeToString(Isolate *isolate, blpapi::Event::EventType et)
@@ -1265,6 +4724,95 @@ eventTypeToString(Isolate *isolate, blpapi::Event::EventType et)
                 String::NewFromUtf8(isolate, "Invalid event type.")));
 }
 
+Local<String>
+Session::internName(Isolate *isolate, const blpapi::Name& name)
+{
+    std::map<blpapi_Name_t *, Persistent<String> *>::iterator f =
+        d_names.find(name.impl());
+    if (f != d_names.end()) {
+        return Local<String>::New(isolate, *f->second);
+    }
+
+    Local<String> s = String::NewFromUtf8(isolate,
+                                          name.string(),
+                                          String::kInternalizedString,
+                                          name.length());
+    d_names[name.impl()] = new Persistent<String>(isolate, s);
+    return s;
+}
+
+Local<String>
+Session::internTopic(Isolate *isolate, const char *topic)
+{
+    if (!topic || !*topic) {
+        return String::Empty(isolate);
+    }
+
+    // Topics are bounded by the subscriptions of the session, but cap the
+    // table in case a service produces an unbounded set of them.
+    static const std::size_t MAX_TOPICS = 65536;
+
+    std::string key(topic);
+    std::map<std::string, Persistent<String> *>::iterator f =
+        d_topics.find(key);
+    if (f != d_topics.end()) {
+        return Local<String>::New(isolate, *f->second);
+    }
+
+    Local<String> s = String::NewFromUtf8(isolate,
+                                          topic,
+                                          String::kInternalizedString,
+                                          static_cast<int>(key.length()));
+    if (d_topics.size() < MAX_TOPICS) {
+        d_topics[key] = new Persistent<String>(isolate, s);
+    }
+    return s;
+}
+
+Local<String>
+Session::internEventType(Isolate *isolate, blpapi::Event::EventType et)
+{
+    const int index = static_cast<int>(et);
+    if (index < 0 || index > BLPAPI_EVENTTYPE_REQUEST) {
+        return eventTypeToString(isolate, et)->ToString();
+    }
+
+    if (d_event_types[index].IsEmpty()) {
+        d_event_types[index].Reset(isolate,
+                                   eventTypeToString(isolate, et)->ToString());
+    }
+    return Local<String>::New(isolate, d_event_types[index]);
+}
+
+void
+Session::clearInterned()
+{
+    for (std::map<blpapi_Name_t *, Persistent<String> *>::iterator it =
+             d_names.begin(); it != d_names.end(); ++it) {
+        it->second->Reset();
+        delete it->second;
+    }
+    d_names.clear();
+
+    for (std::map<std::string, Persistent<String> *>::iterator it =
+             d_topics.begin(); it != d_topics.end(); ++it) {
+        it->second->Reset();
+        delete it->second;
+    }
+    d_topics.clear();
+
+    for (int i = 0; i <= BLPAPI_EVENTTYPE_REQUEST; ++i) {
+        d_event_types[i].Reset();
+    }
+
+    for (std::map<blpapi_Name_t *, DataTemplate *>::iterator it =
+             d_data_templates.begin(); it != d_data_templates.end(); ++it) {
+        it->second->d_template.Reset();
+        delete it->second;
+    }
+    d_data_templates.clear();
+}
+
 void
 Session::processMessage(Isolate *isolate,
                         blpapi::Event::EventType et,
@@ -1272,21 +4820,63 @@ Session::processMessage(Isolate *isolate,
 {
     HandleScope scope(isolate);
 
-    Handle<Value> argv[2];
+    // Names are interned by the SDK, so comparing against these compares
+    // pointers rather than strings.
+    static const blpapi::Name SESSION_TERMINATED("SessionTerminated");
+    static const blpapi::Name AUTHORIZATION_SUCCESS("AuthorizationSuccess");
+    static const blpapi::Name AUTHORIZATION_FAILURE("AuthorizationFailure");
+    static const blpapi::Name AUTHORIZATION_RESPONSE("AuthorizationResponse");
+    static const blpapi::Name ENTITLEMENT_CHANGED("EntitlementChanged");
+    static const blpapi::Name AUTHORIZATION_REVOKED("AuthorizationRevoked");
+    static const blpapi::Name SERVICE_OPENED("ServiceOpened");
+    static const blpapi::Name SERVICE_OPEN_FAILURE("ServiceOpenFailure");
+    static const blpapi::Name SUBSCRIPTION_FAILURE("SubscriptionFailure");
+    static const blpapi::Name SUBSCRIPTION_TERMINATED(
+                                                    "SubscriptionTerminated");
+
+    const uint64_t start = uv_hrtime();
+
+    Handle<Value> type;
 
     blpapi::Name messageType = msg.messageType();
     bool isAuthSuccess = false;
     bool isAuthFailure = false;
-    if ("SessionTerminated" == messageType) {
+    if (SESSION_TERMINATED == messageType) {
         d_stopped = true;
     }
-    else if ("AuthorizationSuccess" == messageType) {
+    else if (AUTHORIZATION_SUCCESS == messageType) {
         isAuthSuccess = true;
     }
-    else if ("AuthorizationFailure" == messageType) {
+    else if (AUTHORIZATION_FAILURE == messageType) {
         isAuthFailure = true;
     }
 
+    // Responses to `authorizeUsers` only settle its promise.
+    if ((isAuthSuccess || isAuthFailure ||
+         blpapi::Event::REQUEST_STATUS == et) &&
+        !d_user_authorizations.empty()) {
+        UserAuthorizationMap::iterator it =
+                          d_user_authorizations.find(msg.correlationId(0));
+        if (it != d_user_authorizations.end()) {
+            completeUserAuthorization(isolate, it, msg, isAuthSuccess);
+            return;
+        }
+    }
+
+    // Cached identities are authorized again once their entitlements
+    // change.
+    if (blpapi::Event::AUTHORIZATION_STATUS == et &&
+        !d_cached_cids.empty() &&
+        (ENTITLEMENT_CHANGED == messageType ||
+         AUTHORIZATION_REVOKED == messageType)) {
+        std::map<blpapi::CorrelationId, std::string>::iterator it =
+                                  d_cached_cids.find(msg.correlationId(0));
+        if (it != d_cached_cids.end()) {
+            d_identity_cache.erase(it->second);
+            d_cached_cids.erase(it);
+        }
+    }
+
     Local<Object> identityObj;
 
     if (isAuthSuccess || isAuthFailure) {
@@ -1294,10 +4884,10 @@ Session::processMessage(Isolate *isolate,
         // generic AuthorizationResponse to simplify handling in the js. Client
         // code can distinguish between them by checking for the identity
         // object, which is only present for successes.
-        messageType = blpapi::Name("AuthorizationResponse");
+        messageType = AUTHORIZATION_RESPONSE;
         if (et == blpapi::Event::RESPONSE) {
-            std::map<int, blpapi::Identity>::iterator f =
-                d_identities.find(msg.correlationId(0).asInteger());
+            std::map<blpapi::CorrelationId, blpapi::Identity>::iterator f =
+                d_identities.find(msg.correlationId(0));
             if (f != d_identities.end()) {
                 if (isAuthSuccess) {
                     identityObj = Identity::New(isolate, f->second);
@@ -1307,53 +4897,455 @@ Session::processMessage(Isolate *isolate,
         }
     }
 
-    argv[0] = String::NewFromUtf8(isolate,
-                                  messageType.string(),
-                                  String::kNormalString,
-                                  messageType.length());
+    type = internName(isolate, messageType);
+
+    // Messages for the chunks of a request are reported as messages for the
+    // request, which completes once the event completing its last chunk
+    // has been dispatched.
+    blpapi::CorrelationId reportedCid;
+    Local<Object> stats;
+    bool isChunk = false;
+    if ((blpapi::Event::PARTIAL_RESPONSE == et ||
+         blpapi::Event::RESPONSE == et ||
+         blpapi::Event::REQUEST_STATUS == et) &&
+        (!d_chunks.empty() || !d_chunk_tails.empty())) {
+        ChunkMap::iterator chunk = d_chunks.find(msg.correlationId(0));
+        ChunkTailMap::iterator tail = d_chunk_tails.find(msg.correlationId(0));
+        if (chunk != d_chunks.end()) {
+            reportedCid = chunk->second.first->d_cid;
+            et = completeChunk(isolate, chunk, et, &stats);
+            isChunk = true;
+        } else if (tail != d_chunk_tails.end()) {
+            reportedCid = tail->second.first;
+            et = tail->second.second;
+            isChunk = true;
+        }
+    }
 
-    Local<Object> o = Object::New(isolate);
-    o->ForceSet(Local<String>::New(isolate, s_event_type),
-                eventTypeToString(isolate, et),
-                (PropertyAttribute)(ReadOnly | DontDelete));
-    o->ForceSet(Local<String>::New(isolate, s_message_type),
-                argv[0],
-                (PropertyAttribute)(ReadOnly | DontDelete));
-    o->ForceSet(Local<String>::New(isolate, s_topic_name),
-                String::NewFromUtf8(isolate, msg.topicName()),
-                (PropertyAttribute)(ReadOnly | DontDelete));
+    // Messages for an `authorize` are reported with its correlation id, and
+    // settle its promise once the authorization completes.
+    PendingAuthorization *auth = 0;
+    if ((blpapi::Event::TOKEN_STATUS == et ||
+         blpapi::Event::REQUEST_STATUS == et ||
+         isAuthSuccess || isAuthFailure) && !d_authorizations.empty()) {
+        AuthorizationMap::iterator it =
+                             d_authorizations.find(msg.correlationId(0));
+        if (it != d_authorizations.end()) {
+            auth = it->second;
+            reportedCid = auth->d_cid;
+            d_authorizations.erase(it);
+            if (blpapi::Event::TOKEN_STATUS == et) {
+                requestAuthorization(isolate, auth, msg);
+                auth = 0;
+            }
+        }
+    }
+    const bool isRemapped =
+        blpapi::CorrelationId::UNSET_VALUE != reportedCid.valueType();
 
     Local<Array> correlations = Array::New(isolate, msg.numCorrelationIds());
     for (int i = 0, j = 0; i < msg.numCorrelationIds(); ++i) {
-        blpapi::CorrelationId cid = msg.correlationId(i);
-        // Only pack user-specified integers and auto-generated
-        // values into the correlations array returned to the user.
-        if (cid.valueType() == blpapi::CorrelationId::INT_VALUE ||
-            cid.valueType() == blpapi::CorrelationId::AUTOGEN_VALUE) {
+        blpapi::CorrelationId cid = i || !isRemapped ? msg.correlationId(i)
+                                                  : reportedCid;
+        // Only pack user-specified integers and objects, and
+        // auto-generated values into the correlations array returned to
+        // the user.
+        Local<Value> value = correlationValue(isolate, cid);
+        if (!value->IsUndefined()) {
             Local<Object> cido = Object::New(isolate);
-            cido->Set(Local<String>::New(isolate, s_value),
-                      Integer::New(isolate, (int)cid.asInteger()));
+            cido->Set(Local<String>::New(isolate, s_value), value);
             cido->Set(Local<String>::New(isolate, s_class_id),
-                      Integer::New(isolate, cid.classId()));
+                      Integer::New(isolate,
+                                   OBJECT_CORRELATION_CLASS_ID == cid.classId()
+                                       ? 0 : cid.classId()));
             correlations->Set(j++, cido);
         } else {
             correlations->Set(j++, Object::New(isolate));
         }
     }
 
-    Local<Object> data = elementToValue(isolate, msg.asElement())->ToObject();
-    o->ForceSet(Local<String>::New(isolate, s_correlations),
-                correlations, (PropertyAttribute)(ReadOnly | DontDelete));
+    Local<Object> data;
+    std::map<blpapi::CorrelationId, std::vector<blpapi::Name> >::iterator
+                                                  proj = d_projections.end();
+    if (blpapi::Event::SUBSCRIPTION_DATA == et && !d_projections.empty()) {
+        proj = d_projections.find(msg.correlationId(0));
+    }
+    std::set<blpapi::CorrelationId>::iterator col = d_columnar.end();
+    if ((blpapi::Event::PARTIAL_RESPONSE == et ||
+         blpapi::Event::RESPONSE == et ||
+         blpapi::Event::REQUEST_STATUS == et) && !d_columnar.empty()) {
+        col = d_columnar.find(isRemapped ? reportedCid : msg.correlationId(0));
+    }
+    std::map<blpapi::CorrelationId, std::vector<blpapi::Message> >::iterator
+                                            merged = d_merged_updates.end();
+    if (blpapi::Event::SUBSCRIPTION_DATA == et && !d_merged_updates.empty()) {
+        merged = d_merged_updates.find(msg.correlationId(0));
+    }
+    if (col != d_columnar.end()) {
+        data = columnarElementToValue(isolate, msg.asElement())->ToObject();
+        if (blpapi::Event::PARTIAL_RESPONSE != et && !isChunk) {
+            d_columnar.erase(col);
+        }
+    } else if (merged != d_merged_updates.end()) {
+        data = mergeElements(isolate,
+                             msg,
+                             merged->second,
+                             proj != d_projections.end() ? &proj->second : 0)
+                                                                ->ToObject();
+        d_merged_updates.erase(merged);
+    } else if (d_lazy_data) {
+        data = MessageData::New(isolate, this, msg);
+    } else if (proj != d_projections.end()) {
+        data = projectElement(isolate, msg.asElement(), proj->second)
+                                                                ->ToObject();
+    } else {
+        data = dataToValue(isolate, messageType, msg.asElement())
+                                                                ->ToObject();
+    }
+
+    if (!identityObj.IsEmpty()) {
+        if (d_lazy_data) {
+            MessageData::setCached(data,
+                                   Local<String>::New(isolate, s_identity),
+                                   identityObj);
+        } else {
+            data->ForceSet(Local<String>::New(isolate, s_identity),
+                           identityObj);
+        }
+    }
+
+    Local<Object> o = newMessage(isolate,
+                                 internEventType(isolate, et),
+                                 type,
+                                 internTopic(isolate, msg.topicName()),
+                                 correlations,
+                                 data);
+    if (!stats.IsEmpty()) {
+        o->Set(Local<String>::New(isolate, s_stats), stats);
+    }
+    if (d_record_times) {
+        setMessageTimes(isolate, o, msg, start);
+    }
+    if (auth) {
+        if (isAuthSuccess) {
+            settleAuthorization(isolate, auth, true, o);
+        } else {
+            Local<Object> error = Exception::Error(String::NewFromUtf8(
+                              isolate, "Authorization failed."))->ToObject();
+            error->Set(Local<String>::New(isolate, s_data), data);
+            settleAuthorization(isolate, auth, false, error);
+        }
+    }
+
+    // A request, including an `authorizeUser`, no longer uses its
+    // correlation once it completes, nor does an `openService` once the
+    // service opened or failed to.  Those of an `authorize` are released
+    // when its promise settles.
+    if ((blpapi::Event::RESPONSE == et ||
+         blpapi::Event::REQUEST_STATUS == et ||
+         SERVICE_OPENED == messageType ||
+         SERVICE_OPEN_FAILURE == messageType) && !isChunk && !auth &&
+        !d_correlation_objects.empty()) {
+        releaseCorrelation(isRemapped ? reportedCid : msg.correlationId(0));
+    }
+
+    const uint64_t converted = uv_hrtime();
+
+    // Messages of a subscription with a callback are passed to it directly.
+    bool called = false;
+    if ((blpapi::Event::SUBSCRIPTION_DATA == et ||
+         blpapi::Event::SUBSCRIPTION_STATUS == et) && !d_callbacks.empty()) {
+        std::map<blpapi::CorrelationId, Persistent<Function> *>::iterator it =
+                                     d_callbacks.find(msg.correlationId(0));
+        if (it != d_callbacks.end()) {
+            Handle<Value> argv[1] = { o };
+            node::MakeCallback(isolate,
+                               isolate->GetCurrentContext()->Global(),
+                               Local<Function>::New(isolate, *it->second),
+                               1,
+                               argv);
+            called = true;
+        }
+    }
+    if (!called) {
+        deliver(isolate, type, o);
+    }
+
+    // A subscription that failed or was terminated is over, as if it had
+    // been cancelled.
+    if (blpapi::Event::SUBSCRIPTION_STATUS == et &&
+        (SUBSCRIPTION_FAILURE == messageType ||
+         SUBSCRIPTION_TERMINATED == messageType) &&
+        msg.numCorrelationIds() > 0) {
+        forgetSubscription(msg.correlationId(0));
+    }
+    recordMessage(messageType, converted - start, uv_hrtime() - converted);
+}
+
+// Set on the specified `message` object the times at which `msg` was
+// received by the SDK, if it recorded it, pushed on the native queue, and
+// dispatched at the specified `dispatched`, all in nanoseconds of
+// `uv_hrtime`, which is the clock of `process.hrtime()`.  Must be called
+// while `msg` belongs to the event at the front of the queue.
+void
+Session::setMessageTimes(Isolate               *isolate,
+                         Handle<Object>         message,
+                         const blpapi::Message& msg,
+                         uint64_t               dispatched)
+{
+    const PropertyAttribute attr = (PropertyAttribute)(ReadOnly | DontDelete);
+
+    blpapi::TimePoint received;
+    if (0 == msg.timeReceived(&received)) {
+        // The epoch of the SDK's clock is unspecified, so translate the
+        // time received through the age of the message.
+        const blpapi::TimePoint now = blpapi::HighResolutionClock::now();
+        const uint64_t hrnow = uv_hrtime();
+        const long long age =
+                   blpapi::TimePointUtil::nanosecondsBetween(received, now);
+        const double time = static_cast<double>(hrnow) -
+                            static_cast<double>(age);
+        message->ForceSet(Local<String>::New(isolate, s_time_received),
+                          Number::New(isolate, time),
+                          attr);
+
+        // The time from receipt to dispatch, as `hrnow` is later.
+        const long long waited =
+                       age - static_cast<long long>(hrnow - dispatched);
+        d_receive_times.record(waited > 0 ? waited : 0);
+    }
+    message->ForceSet(Local<String>::New(isolate, s_time_enqueued),
+                      Number::New(isolate, static_cast<double>(
+                                                      d_que.frontTime())),
+                      attr);
+    message->ForceSet(Local<String>::New(isolate, s_time_dispatched),
+                      Number::New(isolate, static_cast<double>(dispatched)),
+                      attr);
+}
+
+// Record the specified times, in nanoseconds, spent converting and
+// delivering a message of the specified `messageType`.
+void
+Session::recordMessage(const blpapi::Name& messageType,
+                       uint64_t            conversion,
+                       uint64_t            emit)
+{
+    // Messages mostly come in runs of one type, so remember the last.
+    MessageStats *stats = d_last_message_stats;
+    if (!stats || stats->d_name != messageType) {
+        MessageStats *& entry = d_message_stats[messageType.impl()];
+        if (!entry) {
+            entry = new MessageStats;
+            entry->d_name = messageType;
+        }
+        stats = d_last_message_stats = entry;
+    }
+    stats->d_conversion.record(conversion);
+    stats->d_emit.record(emit);
+}
+
+Local<Object>
+Session::histogramToValue(Isolate *isolate, const Histogram& histogram)
+{
+    static const struct {
+        const char *d_name;
+        double      d_percent;
+    } PERCENTILES[] = {
+        { "p50", 50 }, { "p90", 90 }, { "p99", 99 }, { "p999", 99.9 }
+    };
+
+    Local<Object> o = Object::New(isolate);
+    o->Set(String::NewFromUtf8(isolate, "count"),
+           Number::New(isolate, static_cast<double>(histogram.count())));
+    o->Set(String::NewFromUtf8(isolate, "min"),
+           Number::New(isolate, static_cast<double>(histogram.min())));
+    o->Set(String::NewFromUtf8(isolate, "mean"),
+           Number::New(isolate, histogram.mean()));
+    for (std::size_t i = 0;
+         i < sizeof(PERCENTILES) / sizeof(PERCENTILES[0]);
+         ++i) {
+        o->Set(String::NewFromUtf8(isolate, PERCENTILES[i].d_name),
+               Number::New(isolate, static_cast<double>(
+                         histogram.percentile(PERCENTILES[i].d_percent))));
+    }
+    o->Set(String::NewFromUtf8(isolate, "max"),
+           Number::New(isolate, static_cast<double>(histogram.max())));
+    return o;
+}
+
+void
+Session::clearStats()
+{
+    for (std::map<blpapi_Name_t *, MessageStats *>::iterator it =
+             d_message_stats.begin();
+         it != d_message_stats.end();
+         ++it) {
+        delete it->second;
+    }
+    d_message_stats.clear();
+    d_last_message_stats = NULL;
+}
+
+void
+Session::emitQueueStatus(Isolate *isolate, const char *messageType)
+{
+    HandleScope scope(isolate);
+
+    Handle<Value> type;
+
+    type = String::NewFromUtf8(isolate, messageType);
+
+    Local<Object> data = Object::New(isolate);
+    data->Set(Local<String>::New(isolate, s_queue_depth),
+              Integer::NewFromUnsigned(isolate, d_que.size()));
+    data->Set(Local<String>::New(isolate, s_queue_size),
+              Integer::NewFromUnsigned(isolate, d_que.capacity()));
+    data->Set(Local<String>::New(isolate, s_dropped),
+              Number::New(isolate, d_dropped));
+    data->Set(Local<String>::New(isolate, s_conflated),
+              Number::New(isolate, d_conflated));
+
+    deliver(isolate, type, newMessage(isolate,
+                                      internEventType(isolate,
+                                                      blpapi::Event::ADMIN),
+                                      type,
+                                      String::Empty(isolate),
+                                      Array::New(isolate, 0),
+                                      data));
+}
 
+Local<Object>
+Session::newMessage(Isolate       *isolate,
+                    Handle<Value>  eventType,
+                    Handle<Value>  messageType,
+                    Handle<Value>  topicName,
+                    Handle<Value>  correlations,
+                    Handle<Value>  data)
+{
+    Local<Object> o = s_message_template.Get(isolate)->NewInstance();
+    o->ForceSet(Local<String>::New(isolate, s_event_type),
+                eventType,
+                (PropertyAttribute)(ReadOnly | DontDelete));
+    o->ForceSet(Local<String>::New(isolate, s_message_type),
+                messageType,
+                (PropertyAttribute)(ReadOnly | DontDelete));
+    o->ForceSet(Local<String>::New(isolate, s_topic_name),
+                topicName,
+                (PropertyAttribute)(ReadOnly | DontDelete));
+    o->ForceSet(Local<String>::New(isolate, s_correlations),
+                correlations,
+                (PropertyAttribute)(ReadOnly | DontDelete));
     o->ForceSet(Local<String>::New(isolate, s_data), data);
+    return o;
+}
 
-    if (!identityObj.IsEmpty()) {
-        data->ForceSet(Local<String>::New(isolate, s_identity), identityObj);
+void
+Session::checkSlowConsumer(Isolate *isolate)
+{
+    const unsigned int depth = d_que.size();
+    if (!d_slow_consumer && depth >= d_hi_water_mark) {
+        d_slow_consumer = true;
+        emitQueueStatus(isolate, "NativeSlowConsumerWarning");
+    } else if (d_slow_consumer && depth <= d_lo_water_mark) {
+        d_slow_consumer = false;
+        emitQueueStatus(isolate, "NativeSlowConsumerWarningCleared");
+    }
+}
+
+bool
+Session::dropEvent(const blpapi::Event& ev)
+{
+    if (DROP_OLDEST != d_slow_consumer_policy || !d_slow_consumer ||
+        blpapi::Event::SUBSCRIPTION_DATA != ev.eventType()) {
+        return false;
     }
 
-    argv[1] = o;
+    // An event within the window of the last scan no longer supersedes
+    // the updates queued before it.
+    const bool isScanned = d_update_window > 0;
+    if (isScanned) {
+        --d_update_window;
+    }
 
-    this->emit(isolate, sizeof(argv) / sizeof(argv[0]), argv);
+    blpapi::MessageIterator msgIter(ev);
+    while (msgIter.next()) {
+        ++d_dropped;
+        const blpapi::Message& msg = msgIter.message();
+        if (!isScanned || d_pending_updates.empty() ||
+            0 == msg.numCorrelationIds()) {
+            continue;
+        }
+        std::map<blpapi::CorrelationId, unsigned int>::iterator f =
+            d_pending_updates.find(msg.correlationId(0));
+        if (f != d_pending_updates.end() && 0 == --f->second) {
+            // This was the latest queued update for the topic, so the
+            // updates kept to be merged into it are dropped with it.
+            d_pending_updates.erase(f);
+            d_merged_updates.erase(msg.correlationId(0));
+        }
+    }
+    return true;
+}
+
+void
+Session::scanUpdates()
+{
+    // Each scan covers the events queued at that point, and counts the
+    // updates pending per topic so that all but the last can be skipped.
+    if (0 == d_update_window) {
+        d_pending_updates.clear();
+        // Merged updates whose latest update was dropped are stale.
+        d_merged_updates.clear();
+        if (!d_merge_updates &&
+            (CONFLATE != d_slow_consumer_policy || !d_slow_consumer)) {
+            return;
+        }
+
+        d_update_window = d_que.size();
+        for (unsigned int i = 0; i < d_update_window; ++i) {
+            const blpapi::Event& ev = d_que.at(i);
+            if (blpapi::Event::SUBSCRIPTION_DATA != ev.eventType()) {
+                continue;
+            }
+            blpapi::MessageIterator msgIter(ev);
+            while (msgIter.next()) {
+                const blpapi::Message& msg = msgIter.message();
+                if (msg.numCorrelationIds() > 0) {
+                    ++d_pending_updates[msg.correlationId(0)];
+                }
+            }
+        }
+    }
+    --d_update_window;
+}
+
+bool
+Session::conflateMessage(blpapi::Event::EventType  et,
+                         const blpapi::Message&    msg)
+{
+    if (d_pending_updates.empty() ||
+        blpapi::Event::SUBSCRIPTION_DATA != et ||
+        0 == msg.numCorrelationIds()) {
+        return false;
+    }
+
+    std::map<blpapi::CorrelationId, unsigned int>::iterator f =
+        d_pending_updates.find(msg.correlationId(0));
+    if (f == d_pending_updates.end()) {
+        return false;
+    }
+    if (0 == --f->second) {
+        // This is the latest queued update for the topic.
+        d_pending_updates.erase(f);
+        return false;
+    }
+    if (d_merge_updates) {
+        // Keep the update, so that its fields can be merged into the
+        // latest one.
+        d_merged_updates[msg.correlationId(0)].push_back(msg);
+    }
+    ++d_conflated;
+    return true;
 }
 
 void
@@ -1363,82 +5355,257 @@ Session::processEvents(uv_async_t *async)
     HandleScope scope(isolate);
     Session *session = reinterpret_cast<Session *>(async->data);
 
-    bool empty;
-    do {
-        {
-            // Create a block scope to ensure the `MessageIterator` is
-            // destroyed before potentially destroying the `Session`.
-
-            // Determine if the queue is empty
-            uv_mutex_lock(&session->d_que_mutex);
-            empty = session->d_que.empty();
-            if (empty) {
-                uv_mutex_unlock(&session->d_que_mutex);
+    // Bound the work done per wakeup so a burst of events can not starve
+    // timers and I/O on the event loop.  Once the budget is spent, the
+    // position within the current event is kept and the handle re-armed.
+    uint64_t deadline = 0;
+    if (session->d_max_dispatch_time) {
+        deadline = uv_hrtime() + session->d_max_dispatch_time;
+    }
+    unsigned int dispatched = 0;
+    bool yield = false;
+
+    while (!yield) {
+        // Once the queue is empty, mark the consumer idle so the next
+        // event posted requests a wakeup, unless one raced in meanwhile.
+        if (session->d_que.empty() && session->d_que.idle()) {
+            session->sweepCorrelations(true);
+            break;
+        }
+
+        const blpapi::Event& ev = session->d_que.front();
+
+        // Iterate over contained messages, resuming where the previous
+        // call left off if it ran out of budget.
+        if (!session->d_msg_iter) {
+            // Starting a new event: record how long it waited, compare the
+            // queue depth against its water marks and apply the slow
+            // consumer policy.  The queue only grows between pops, so its
+            // depth is at its highest here.
+            session->d_queue_times.record(
+                              uv_hrtime() - session->d_que.frontTime());
+            session->d_max_depth = std::max(session->d_max_depth,
+                                            session->d_que.size());
+            session->d_dispatching = true;
+            session->checkSlowConsumer(isolate);
+            session->d_dispatching = false;
+            if (!session->d_destroy) {
+                if (session->dropEvent(ev)) {
+                    session->d_que.pop();
+                    continue;
+                }
+                session->scanUpdates();
+                session->d_msg_iter = new blpapi::MessageIterator(ev);
+            }
+        }
+        bool exhausted = false;
+        while (!yield && !session->d_destroy) {
+            if (!session->d_msg_iter->next()) {
+                exhausted = true;
                 break;
             }
+            const blpapi::Message& msg = session->d_msg_iter->message();
+            if (session->d_cache_last_values &&
+                blpapi::Event::SUBSCRIPTION_DATA == ev.eventType() &&
+                msg.numCorrelationIds() > 0) {
+                session->cacheLastValues(msg);
+            }
+            // Skip updates superseded by a newer one still in the queue.
+            if (session->conflateMessage(ev.eventType(), msg))
+                continue;
+            // Indicate a message is being dispatched and break if
+            // the callback winds up destroying the session.  The
+            // session can not be directly destroyed in `::Destroy`
+            // because the `MessageIterator` requires the session
+            // to still exist.
+            session->d_dispatching = true;
+            session->processMessage(isolate, ev.eventType(), msg);
+            session->d_dispatching = false;
+            if (session->d_destroy)
+                break;
 
-            // Keep the lock and release once the head is retrieved
-            const blpapi::Event& ev = session->d_que.front();
-            uv_mutex_unlock(&session->d_que_mutex);
+            ++dispatched;
+            yield = (session->d_max_dispatch_messages &&
+                     dispatched >= session->d_max_dispatch_messages) ||
+                    (deadline && uv_hrtime() >= deadline);
+        }
 
-            // Iterate over contained messages without holding lock
-            blpapi::MessageIterator msgIter(ev);
-            while (msgIter.next()) {
-                const blpapi::Message& msg = msgIter.message();
-                // Indicate a message is being dispatched and break if
-                // the callback winds up destroying the session.  The
-                // session can not be directly destroyed in `::Destroy`
-                // because the `MessageIterator` requires the session
-                // to still exist.
+        if (exhausted) {
+            delete session->d_msg_iter;
+            session->d_msg_iter = NULL;
+            if (!session->d_chunk_tails.empty()) {
+                session->finishChunks();
+            }
+
+            session->d_que.pop();
+            session->sweepCorrelations(false);
+
+            if (session->d_max_batch_events &&
+                ++session->d_batch_events >= session->d_max_batch_events) {
                 session->d_dispatching = true;
-                session->processMessage(isolate, ev.eventType(), msg);
+                session->flushBatch(isolate);
                 session->d_dispatching = false;
-                if (session->d_destroy)
-                    break;
             }
         }
 
-        // Reacquire and pop, updating empty flag to having to
-        // loop and acquire the mutex for a second time.
-        uv_mutex_lock(&session->d_que_mutex);
         if (session->d_destroy) {
-            // Drain the queue, as `Event` release requires `Session`
-            session->d_que.clear();
-            empty = true;
-            // Destroy the `blpapi::Session`
-            delete session->d_session;
-            session->d_session = NULL;
-            session->d_destroy = false;
-        } else {
-            session->d_que.pop_front();
-            empty = session->d_que.empty();
+            session->release();
+            break;
+        }
+    }
+
+    // Deliver whatever has been batched before returning to the loop.
+    if (session->d_session && session->d_batch_length) {
+        session->d_dispatching = true;
+        session->flushBatch(isolate);
+        session->d_dispatching = false;
+        if (session->d_destroy) {
+            session->release();
         }
-        uv_mutex_unlock(&session->d_que_mutex);
-    } while (!empty);
+    }
+
+    if (yield && session->d_session) {
+        // Let the loop run other callbacks before dispatching the rest.
+        uv_async_send(async);
+    }
+
+    // Release the async handle once the `blpapi::Session` is gone, which
+    // also drops this session's reference on the event loop.
+    if (!session->d_session && session->d_async) {
+        uv_close(reinterpret_cast<uv_handle_t *>(session->d_async),
+                 closeAsync);
+        session->d_async = NULL;
+    }
+}
+
+void
+Session::release()
+{
+    // Ensure the `MessageIterator` is destroyed before destroying the
+    // `Session`, along with any messages still referenced by lazy `data`
+    // objects.
+    delete d_msg_iter;
+    d_msg_iter = NULL;
+    while (d_live_data) {
+        d_live_data->detach();
+    }
+    d_merged_updates.clear();
+    clearChunks();
+    clearAuthorizations(true);
+    clearUserAuthorizations(true);
+
+    // Drain the queue, as `Event` release requires `Session`
+    d_que.close();
+    d_que.clear();
+
+    // Destroy the `blpapi::Session`
+    delete d_session;
+    d_session = NULL;
+    d_destroy = false;
+
+    // Messages batched but not yet delivered are discarded.
+    d_batch.Reset();
+    d_batch_length = 0;
+    d_batch_events = 0;
+
+    d_emit.Reset();
+    d_projections.clear();
+    d_columnar.clear();
+    d_identities.clear();
+    d_last_values.clear();
+    clearCallbacks();
+    clearCorrelations();
+    clearInterned();
+}
+
+void
+Session::closeAsync(uv_handle_t *handle)
+{
+    delete reinterpret_cast<uv_async_t *>(handle);
 }
 
 bool
 Session::processEvent(const blpapi::Event& ev, blpapi::Session* session)
 {
-    uv_mutex_lock(&d_que_mutex);
+    // Only wake the event loop if the Javascript thread is not already
+    // draining the queue.
+    if (d_que.push(ev)) {
+        uv_async_send(d_async);
+    }
+
+    return true;
+}
+
+void
+Session::deliver(Isolate        *isolate,
+                 Handle<Value>   messageType,
+                 Handle<Object>  message)
+{
+    if (!d_max_batch_events) {
+        Handle<Value> argv[2] = { messageType, message };
+        this->emit(isolate, sizeof(argv) / sizeof(argv[0]), argv);
+        return;
+    }
+
+    // In batch mode, messages are collected and delivered together in a
+    // single 'batch' callback by `flushBatch`.
+    Local<Array> batch;
+    if (d_batch.IsEmpty()) {
+        batch = Array::New(isolate);
+        d_batch.Reset(isolate, batch);
+    } else {
+        batch = Local<Array>::New(isolate, d_batch);
+    }
+    batch->Set(d_batch_length++, message);
+}
+
+// Forget the callbacks of every subscription.
+void
+Session::clearCallbacks()
+{
+    for (std::map<blpapi::CorrelationId, Persistent<Function> *>::iterator
+             it = d_callbacks.begin();
+         it != d_callbacks.end();
+         ++it) {
+        it->second->Reset();
+        delete it->second;
+    }
+    d_callbacks.clear();
+}
+
+void
+Session::flushBatch(Isolate *isolate)
+{
+    d_batch_events = 0;
+    if (!d_batch_length) {
+        return;
+    }
 
-    d_que.push_back(ev);
+    HandleScope scope(isolate);
 
-    uv_mutex_unlock(&d_que_mutex);
+    Handle<Value> argv[2];
+    argv[0] = Local<String>::New(isolate, s_batch);
+    argv[1] = Local<Array>::New(isolate, d_batch);
 
-    s_async.data = this;
-    uv_async_send(&s_async);
+    d_batch.Reset();
+    d_batch_length = 0;
 
-    return true;
+    const uint64_t start = uv_hrtime();
+    this->emit(isolate, sizeof(argv) / sizeof(argv[0]), argv);
+    d_batch_emit_times.record(uv_hrtime() - start);
 }
 
 void
 Session::emit(Isolate *isolate, int argc, Handle<Value> argv[])
 {
     HandleScope scope(isolate);
-    Local<Function> emit =
-        Local<Function>::Cast(
+    Local<Function> emit;
+    if (!d_emit.IsEmpty()) {
+        emit = Local<Function>::New(isolate, d_emit);
+    } else {
+        emit = Local<Function>::Cast(
                 handle(isolate)->Get(Local<String>::New(isolate, s_emit)));
+    }
     node::MakeCallback(isolate,
                        isolate->GetCurrentContext()->Global(),
                        emit, argc, argv);
@@ -1450,6 +5617,20 @@ Session::emit(Isolate *isolate, int argc, Handle<Value> argv[])
 void init(Handle<Object> target) {
     BloombergLP::blpapijs::Session::Initialize(target);
     BloombergLP::blpapijs::Identity::Initialize(target);
+    BloombergLP::blpapijs::MessageData::Initialize(target);
+    BloombergLP::blpapijs::RequestTemplate::Initialize(target);
+
+    // Tell the tests whether the module is linked against the fake BLPAPI
+    // library of 'deps/blpapi/fake'.
+    Isolate *isolate = Isolate::GetCurrent();
+#ifdef BLPAPIJS_FAKE
+    const bool fake = true;
+#else
+    const bool fake = false;
+#endif
+    target->Set(String::NewFromUtf8(isolate, "fake",
+                                    v8::String::kInternalizedString),
+                Boolean::New(isolate, fake));
 }
 
 NODE_MODULE(blpapijs, init)
@@ -0,0 +1,2572 @@
+// An in-process stand-in for the BLPAPI C library, against which the
+// binding can be built and exercised without a Bloomberg connection.  It
+// implements the subset of the C API used by `blpapijs.cpp`, with the
+// semantics of the real library where the binding depends on them:
+// reference-counted events and messages, a dispatcher thread calling the
+// session's event handler, auto-generated correlation ids, and the event
+// types and message names of session, service, subscription, request and
+// authorization processing.
+//
+// Services:
+//   //blp/mktdata  Subscriptions produce `MarketDataEvents` from a
+//                  deterministic tick generator.
+//   //blp/refdata  `ReferenceDataRequest`, `HistoricalDataRequest`,
+//                  `IntradayTickRequest` and `IntradayBarRequest` are
+//                  answered immediately with generated data.
+//   //blp/apiauth  Tokens are always generated and authorizations always
+//                  succeed.
+//
+// Field types come from a small built-in schema, falling back on the name
+// of the field, and values are derived from the security name, so that
+// runs are repeatable.  The `FAKE_SEND_TIME` field holds the time a tick
+// was generated, in nanoseconds of the monotonic clock, which is the
+// clock of `process.hrtime()` on Linux.  The tick generators are
+// configured through the environment, and per subscription through its
+// options:
+//
+//   BLPAPI_FAKE_TICK_RATE        (fakeTickRate)   ticks per second for each
+//                                                 subscription, 0 for as
+//                                                 fast as possible; 10
+//   BLPAPI_FAKE_TICK_COUNT       (fakeTickCount)  ticks per subscription, 0
+//                                                 for no limit; 0
+//   BLPAPI_FAKE_MESSAGES_PER_EVENT                most messages packed into
+//                                                 a data event; 1
+//   BLPAPI_FAKE_SEED                              seed of every generator; 1
+//
+// Securities whose name contains `INVALID` fail to subscribe, and are
+// reported with a `securityError` by reference data requests.
+
+#include <blpapi_abstractsession.h>
+#include <blpapi_correlationid.h>
+#include <blpapi_datetime.h>
+#include <blpapi_defs.h>
+#include <blpapi_element.h>
+#include <blpapi_error.h>
+#include <blpapi_event.h>
+#include <blpapi_highresolutionclock.h>
+#include <blpapi_identity.h>
+#include <blpapi_message.h>
+#include <blpapi_name.h>
+#include <blpapi_request.h>
+#include <blpapi_service.h>
+#include <blpapi_session.h>
+#include <blpapi_sessionoptions.h>
+#include <blpapi_subscriptionlist.h>
+#include <blpapi_timepoint.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <pthread.h>
+#include <sys/time.h>
+
+namespace {
+
+// Return the current time in nanoseconds since the epoch.
+blpapi_Int64_t nowNanoseconds()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return static_cast<blpapi_Int64_t>(tv.tv_sec) * 1000000000LL +
+           static_cast<blpapi_Int64_t>(tv.tv_usec) * 1000LL;
+}
+
+// Return the current time in nanoseconds of the monotonic clock.
+blpapi_Int64_t monotonicNanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<blpapi_Int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Return the integer value of the environment variable `name`, or the
+// specified `defaultValue` if it is not set.
+long envValue(const char *name, long defaultValue)
+{
+    const char *v = std::getenv(name);
+    return v && *v ? std::strtol(v, 0, 10) : defaultValue;
+}
+
+// The description of the last error, per thread.
+__thread char t_lastError[256];
+
+int fail(int rc, const std::string& description)
+{
+    std::strncpy(t_lastError, description.c_str(), sizeof(t_lastError) - 1);
+    t_lastError[sizeof(t_lastError) - 1] = 0;
+    return rc;
+}
+
+int addRef(volatile int *count)
+{
+    return __sync_add_and_fetch(count, 1);
+}
+
+int release(volatile int *count)
+{
+    return __sync_sub_and_fetch(count, 1);
+}
+
+// A small linear congruential generator, so that runs are repeatable on
+// every platform.
+class Random {
+    unsigned long long d_state;
+
+  public:
+    explicit Random(unsigned long long seed = 1)
+    : d_state(seed * 6364136223846793005ULL + 1442695040888963407ULL)
+    {
+    }
+
+    unsigned int next()
+    {
+        d_state = d_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<unsigned int>(d_state >> 33);
+    }
+
+    // Return a number in [0, 1).
+    double uniform()
+    {
+        return next() / 2147483648.0;
+    }
+};
+
+unsigned long long hashString(const std::string& s)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        h = (h ^ static_cast<unsigned char>(s[i])) * 1099511628211ULL;
+    }
+    return h;
+}
+
+// Convert the specified nanoseconds since the epoch to a datetime holding
+// the specified `parts`.
+blpapi_HighPrecisionDatetime_t toDatetime(blpapi_Int64_t ns, int parts)
+{
+    time_t sec = static_cast<time_t>(ns / 1000000000LL);
+    struct tm tm;
+    gmtime_r(&sec, &tm);
+
+    blpapi_HighPrecisionDatetime_t dt;
+    std::memset(&dt, 0, sizeof(dt));
+    dt.datetime.parts = static_cast<blpapi_UChar_t>(parts);
+    if (parts & BLPAPI_DATETIME_DATE_PART) {
+        dt.datetime.year = static_cast<blpapi_UInt16_t>(tm.tm_year + 1900);
+        dt.datetime.month = static_cast<blpapi_UChar_t>(tm.tm_mon + 1);
+        dt.datetime.day = static_cast<blpapi_UChar_t>(tm.tm_mday);
+    }
+    if (parts & BLPAPI_DATETIME_TIME_PART) {
+        dt.datetime.hours = static_cast<blpapi_UChar_t>(tm.tm_hour);
+        dt.datetime.minutes = static_cast<blpapi_UChar_t>(tm.tm_min);
+        dt.datetime.seconds = static_cast<blpapi_UChar_t>(tm.tm_sec);
+    }
+    if (parts & BLPAPI_DATETIME_MILLISECONDS_PART) {
+        dt.datetime.milliSeconds =
+                     static_cast<blpapi_UInt16_t>(ns / 1000000 % 1000);
+    }
+    return dt;
+}
+
+// Return the seconds since the epoch of the specified `dt`, taking missing
+// date parts as the epoch and missing time parts as zero.
+blpapi_Int64_t fromDatetime(const blpapi_Datetime_t& dt)
+{
+    struct tm tm;
+    std::memset(&tm, 0, sizeof(tm));
+    tm.tm_year = 70;
+    tm.tm_mday = 1;
+    if (dt.parts & BLPAPI_DATETIME_DATE_PART) {
+        tm.tm_year = dt.year - 1900;
+        tm.tm_mon = dt.month - 1;
+        tm.tm_mday = dt.day;
+    }
+    if (dt.parts & BLPAPI_DATETIME_TIME_PART) {
+        tm.tm_hour = dt.hours;
+        tm.tm_min = dt.minutes;
+        tm.tm_sec = dt.seconds;
+    }
+    return static_cast<blpapi_Int64_t>(timegm(&tm)) -
+           (dt.parts & BLPAPI_DATETIME_OFFSET_PART ? dt.offset * 60 : 0);
+}
+
+// Return the seconds since the epoch of a date given as `YYYYMMDD` or a
+// datetime given as `YYYY-MM-DDTHH:MM:SS`, or -1 if `s` is neither.
+blpapi_Int64_t parseDatetime(const std::string& s)
+{
+    blpapi_Datetime_t dt;
+    std::memset(&dt, 0, sizeof(dt));
+    int y, mo, d, h = 0, mi = 0, sec = 0;
+    if (8 == s.size() &&
+        3 == std::sscanf(s.c_str(), "%4d%2d%2d", &y, &mo, &d)) {
+        dt.parts = BLPAPI_DATETIME_DATE_PART;
+    } else if (std::sscanf(s.c_str(), "%d-%d-%dT%d:%d:%d",
+                           &y, &mo, &d, &h, &mi, &sec) >= 3) {
+        dt.parts = BLPAPI_DATETIME_DATE_PART | BLPAPI_DATETIME_TIME_PART;
+    } else {
+        return -1;
+    }
+    dt.year = static_cast<blpapi_UInt16_t>(y);
+    dt.month = static_cast<blpapi_UChar_t>(mo);
+    dt.day = static_cast<blpapi_UChar_t>(d);
+    dt.hours = static_cast<blpapi_UChar_t>(h);
+    dt.minutes = static_cast<blpapi_UChar_t>(mi);
+    dt.seconds = static_cast<blpapi_UChar_t>(sec);
+    return fromDatetime(dt);
+}
+
+void copyCorrelationId(blpapi_CorrelationId_t       *dst,
+                       const blpapi_CorrelationId_t& src)
+{
+    *dst = src;
+    if (BLPAPI_CORRELATION_TYPE_POINTER == src.valueType &&
+        src.value.ptrValue.manager) {
+        src.value.ptrValue.manager(&dst->value.ptrValue,
+                                   &src.value.ptrValue,
+                                   BLPAPI_MANAGEDPTR_COPY);
+    }
+}
+
+void destroyCorrelationId(blpapi_CorrelationId_t *cid)
+{
+    if (BLPAPI_CORRELATION_TYPE_POINTER == cid->valueType &&
+        cid->value.ptrValue.manager) {
+        cid->value.ptrValue.manager(&cid->value.ptrValue,
+                                    0,
+                                    BLPAPI_MANAGEDPTR_DESTROY);
+    }
+}
+
+// Correlation ids compare by type and value, as in the real library.
+struct CorrelationKey {
+    unsigned int        d_type;
+    unsigned long long  d_value;
+
+    explicit CorrelationKey(const blpapi_CorrelationId_t& cid)
+    : d_type(cid.valueType)
+    , d_value(BLPAPI_CORRELATION_TYPE_POINTER == cid.valueType
+                  ? reinterpret_cast<unsigned long long>(
+                                                cid.value.ptrValue.pointer)
+                  : cid.value.intValue)
+    {
+    }
+
+    bool operator<(const CorrelationKey& rhs) const
+    {
+        return d_type < rhs.d_type ||
+               (d_type == rhs.d_type && d_value < rhs.d_value);
+    }
+};
+
+volatile int s_nextAutogen = 0;
+
+void autogenCorrelationId(blpapi_CorrelationId_t *cid)
+{
+    if (BLPAPI_CORRELATION_TYPE_UNSET == cid->valueType) {
+        std::memset(cid, 0, sizeof(*cid));
+        cid->size = sizeof(*cid);
+        cid->valueType = BLPAPI_CORRELATION_TYPE_AUTOGEN;
+        cid->value.intValue = addRef(&s_nextAutogen);
+    }
+}
+
+}  // close unnamed namespace
+
+                                // ===========
+                                // struct Name
+                                // ===========
+
+struct blpapi_Name {
+    std::string d_string;
+};
+
+namespace {
+
+pthread_mutex_t s_namesLock = PTHREAD_MUTEX_INITIALIZER;
+std::map<std::string, blpapi_Name *> *s_names;
+
+// Return the interned name for `s`, creating it if `create` is `true`.
+blpapi_Name *intern(const char *s, bool create = true)
+{
+    pthread_mutex_lock(&s_namesLock);
+    if (!s_names) {
+        s_names = new std::map<std::string, blpapi_Name *>;
+    }
+    blpapi_Name *name = 0;
+    std::map<std::string, blpapi_Name *>::iterator it = s_names->find(s);
+    if (it != s_names->end()) {
+        name = it->second;
+    } else if (create) {
+        name = new blpapi_Name;
+        name->d_string = s;
+        (*s_names)[s] = name;
+    }
+    pthread_mutex_unlock(&s_namesLock);
+    return name;
+}
+
+}  // close unnamed namespace
+
+                               // ==============
+                               // struct Element
+                               // ==============
+
+// A value of a scalar element.  Only the member for the element's type is
+// used, except that `d_string` also caches values formatted as strings.
+struct FakeValue {
+    blpapi_Int64_t                  d_int;
+    blpapi_Float64_t                d_float;
+    std::string                     d_string;
+    blpapi_Name                    *d_name;
+    blpapi_HighPrecisionDatetime_t  d_datetime;
+
+    FakeValue()
+    : d_int(0), d_float(0), d_name(0)
+    {
+        std::memset(&d_datetime, 0, sizeof(d_datetime));
+    }
+};
+
+// An element of a message or request.  Complex elements hold their
+// sub-elements, and arrays of complex elements hold one sequence element
+// per entry.  Elements of requests have no schema: sub-elements are
+// created when first looked up, and take the type of their first value.
+struct blpapi_Element {
+    blpapi_Name                    *d_name;
+    int                             d_datatype;  // 0 until known
+    bool                            d_isArray;
+    bool                            d_writable;
+    std::vector<FakeValue>          d_values;
+    std::vector<blpapi_Element *>   d_elements;
+
+    blpapi_Element(blpapi_Name *name, int datatype, bool writable)
+    : d_name(name), d_datatype(datatype), d_isArray(false)
+    , d_writable(writable)
+    {
+    }
+
+    ~blpapi_Element()
+    {
+        for (std::size_t i = 0; i < d_elements.size(); ++i) {
+            delete d_elements[i];
+        }
+    }
+
+    bool isComplex() const
+    {
+        return BLPAPI_DATATYPE_SEQUENCE == d_datatype ||
+               BLPAPI_DATATYPE_CHOICE == d_datatype;
+    }
+
+    std::size_t numValues() const
+    {
+        if (isComplex()) {
+            return d_isArray ? d_elements.size() : 1;
+        }
+        return d_values.size();
+    }
+
+    blpapi_Element *find(const blpapi_Name *name) const
+    {
+        for (std::size_t i = 0; i < d_elements.size(); ++i) {
+            if (d_elements[i]->d_name == name) {
+                return d_elements[i];
+            }
+        }
+        return 0;
+    }
+
+    // Add a sub-element, and return it.
+    blpapi_Element *add(const char *name, int datatype)
+    {
+        blpapi_Element *e = new blpapi_Element(intern(name),
+                                               datatype,
+                                               d_writable);
+        d_elements.push_back(e);
+        return e;
+    }
+
+    // Add an entry to this array of sequences, and return it.
+    blpapi_Element *append()
+    {
+        d_isArray = true;
+        d_datatype = BLPAPI_DATATYPE_SEQUENCE;
+        blpapi_Element *e = new blpapi_Element(d_name,
+                                               BLPAPI_DATATYPE_SEQUENCE,
+                                               d_writable);
+        d_elements.push_back(e);
+        return e;
+    }
+
+    // Return the value to set at `index` as a value of type `datatype`,
+    // or 0 if it is out of range.
+    FakeValue *slot(std::size_t index, int datatype)
+    {
+        if (!d_writable && d_datatype) {
+            datatype = d_datatype;
+        }
+        d_datatype = datatype;
+        if (BLPAPI_ELEMENT_INDEX_END == index) {
+            d_isArray = true;
+            d_values.push_back(FakeValue());
+            return &d_values.back();
+        }
+        if (index == d_values.size()) {
+            d_values.push_back(FakeValue());
+        }
+        return index < d_values.size() ? &d_values[index] : 0;
+    }
+
+    void setFloat(double v, std::size_t index = 0)
+    {
+        slot(index, BLPAPI_DATATYPE_FLOAT64)->d_float = v;
+    }
+
+    void setInt(blpapi_Int64_t v, int datatype, std::size_t index = 0)
+    {
+        slot(index, datatype)->d_int = v;
+    }
+
+    void setString(const std::string& v, std::size_t index = 0)
+    {
+        slot(index, BLPAPI_DATATYPE_STRING)->d_string = v;
+    }
+
+    void setEnum(const char *v, std::size_t index = 0)
+    {
+        slot(index, BLPAPI_DATATYPE_ENUMERATION)->d_name = intern(v);
+    }
+
+    void setDatetime(const blpapi_HighPrecisionDatetime_t& v,
+                     int                                   datatype,
+                     std::size_t                           index = 0)
+    {
+        slot(index, datatype)->d_datetime = v;
+    }
+};
+
+namespace {
+
+// Return the value of `e` at `index` formatted as a string, or an empty
+// string if there is none.
+const std::string& valueString(const blpapi_Element *e, std::size_t index)
+{
+    static const std::string empty;
+    if (e->isComplex() || index >= e->d_values.size()) {
+        return empty;
+    }
+    FakeValue& v = const_cast<FakeValue&>(e->d_values[index]);
+    std::ostringstream ss;
+    switch (e->d_datatype) {
+      case BLPAPI_DATATYPE_STRING:
+        return v.d_string;
+      case BLPAPI_DATATYPE_ENUMERATION:
+        return v.d_name->d_string;
+      case BLPAPI_DATATYPE_BOOL:
+        ss << (v.d_int ? "true" : "false");
+        break;
+      case BLPAPI_DATATYPE_CHAR:
+        ss << static_cast<char>(v.d_int);
+        break;
+      case BLPAPI_DATATYPE_BYTE:
+      case BLPAPI_DATATYPE_INT32:
+      case BLPAPI_DATATYPE_INT64:
+        ss << v.d_int;
+        break;
+      case BLPAPI_DATATYPE_FLOAT32:
+      case BLPAPI_DATATYPE_FLOAT64:
+        ss << v.d_float;
+        break;
+      case BLPAPI_DATATYPE_DATE:
+      case BLPAPI_DATATYPE_TIME:
+      case BLPAPI_DATATYPE_DATETIME: {
+        const blpapi_Datetime_t& dt = v.d_datetime.datetime;
+        char buf[32];
+        if (!(dt.parts & BLPAPI_DATETIME_DATE_PART)) {
+            std::sprintf(buf, "%02d:%02d:%02d.%03d",
+                         dt.hours, dt.minutes, dt.seconds, dt.milliSeconds);
+        } else if (!(dt.parts & BLPAPI_DATETIME_TIME_PART)) {
+            std::sprintf(buf, "%04d-%02d-%02d", dt.year, dt.month, dt.day);
+        } else {
+            std::sprintf(buf, "%04d-%02d-%02dT%02d:%02d:%02d.%03d",
+                         dt.year, dt.month, dt.day,
+                         dt.hours, dt.minutes, dt.seconds, dt.milliSeconds);
+        }
+        ss << buf;
+      } break;
+      default:
+        break;
+    }
+    v.d_string = ss.str();
+    return v.d_string;
+}
+
+void printElement(std::ostream&          os,
+                  const blpapi_Element  *e,
+                  int                    level,
+                  int                    spaces)
+{
+    const std::string indent(level * spaces, ' ');
+    os << indent << e->d_name->d_string;
+    if (e->d_isArray) {
+        os << "[] = {\n";
+        for (std::size_t i = 0; i < e->numValues(); ++i) {
+            if (e->isComplex()) {
+                printElement(os, e->d_elements[i], level + 1, spaces);
+            } else {
+                os << std::string((level + 1) * spaces, ' ')
+                   << valueString(e, i) << "\n";
+            }
+        }
+        os << indent << "}\n";
+    } else if (e->isComplex()) {
+        os << " = {\n";
+        for (std::size_t i = 0; i < e->d_elements.size(); ++i) {
+            printElement(os, e->d_elements[i], level + 1, spaces);
+        }
+        os << indent << "}\n";
+    } else {
+        os << " = " << valueString(e, 0) << "\n";
+    }
+}
+
+// Return the string values of the sub-element `name` of `e`, a single
+// value or an array.
+std::vector<std::string> stringValues(const blpapi_Element *e,
+                                      const char           *name)
+{
+    std::vector<std::string> values;
+    const blpapi_Element *se = e->find(intern(name));
+    if (se) {
+        for (std::size_t i = 0; i < se->d_values.size(); ++i) {
+            values.push_back(valueString(se, i));
+        }
+    }
+    return values;
+}
+
+std::string stringValue(const blpapi_Element *e, const char *name)
+{
+    std::vector<std::string> values = stringValues(e, name);
+    return values.empty() ? std::string() : values[0];
+}
+
+// Return the seconds since the epoch of the datetime or string sub-element
+// `name` of `e`, or -1 if it is missing.
+blpapi_Int64_t datetimeValue(const blpapi_Element *e, const char *name)
+{
+    const blpapi_Element *se = e->find(intern(name));
+    if (!se || se->d_values.empty()) {
+        return -1;
+    }
+    switch (se->d_datatype) {
+      case BLPAPI_DATATYPE_DATE:
+      case BLPAPI_DATATYPE_TIME:
+      case BLPAPI_DATATYPE_DATETIME:
+        return fromDatetime(se->d_values[0].d_datetime.datetime);
+      default:
+        return parseDatetime(valueString(se, 0));
+    }
+}
+
+                              // ================
+                              // namespace schema
+                              // ================
+
+struct FieldType {
+    const char *d_name;
+    int         d_datatype;
+};
+
+const FieldType s_fieldTypes[] = {
+    { "LAST_PRICE",              BLPAPI_DATATYPE_FLOAT64 },
+    { "LAST_TRADE",              BLPAPI_DATATYPE_FLOAT64 },
+    { "BID",                     BLPAPI_DATATYPE_FLOAT64 },
+    { "ASK",                     BLPAPI_DATATYPE_FLOAT64 },
+    { "PX_LAST",                 BLPAPI_DATATYPE_FLOAT64 },
+    { "PX_OPEN",                 BLPAPI_DATATYPE_FLOAT64 },
+    { "PX_HIGH",                 BLPAPI_DATATYPE_FLOAT64 },
+    { "PX_LOW",                  BLPAPI_DATATYPE_FLOAT64 },
+    { "BID_SIZE",                BLPAPI_DATATYPE_INT32 },
+    { "ASK_SIZE",                BLPAPI_DATATYPE_INT32 },
+    { "SIZE_LAST_TRADE",         BLPAPI_DATATYPE_INT32 },
+    { "VOLUME",                  BLPAPI_DATATYPE_INT64 },
+    { "PX_VOLUME",               BLPAPI_DATATYPE_INT64 },
+    { "NAME",                    BLPAPI_DATATYPE_STRING },
+    { "TICKER",                  BLPAPI_DATATYPE_STRING },
+    { "CRNCY",                   BLPAPI_DATATYPE_STRING },
+    { "ID_ISIN",                 BLPAPI_DATATYPE_STRING },
+    { "SECURITY_TYP",            BLPAPI_DATATYPE_STRING },
+    { "TRADING_DT_REALTIME",     BLPAPI_DATATYPE_DATE },
+    { "LAST_UPDATE_DT",          BLPAPI_DATATYPE_DATE },
+    { "TRADE_UPDATE_STAMP_RT",   BLPAPI_DATATYPE_DATETIME },
+    { "TIME",                    BLPAPI_DATATYPE_TIME },
+    { "IS_DELAYED_STREAM",       BLPAPI_DATATYPE_BOOL },
+    { "FAKE_SEND_TIME",          BLPAPI_DATATYPE_INT64 }
+};
+
+// Return the type of the field `name`: from the schema if it is known,
+// and otherwise from the conventions of field names.
+int fieldType(const std::string& name)
+{
+    for (std::size_t i = 0;
+         i < sizeof(s_fieldTypes) / sizeof(s_fieldTypes[0]);
+         ++i) {
+        if (name == s_fieldTypes[i].d_name) {
+            return s_fieldTypes[i].d_datatype;
+        }
+    }
+    if (name.find("SIZE") != std::string::npos ||
+        name.find("VOLUME") != std::string::npos ||
+        0 == name.find("NUM_")) {
+        return BLPAPI_DATATYPE_INT64;
+    }
+    if (name.size() > 3 && 0 == name.compare(name.size() - 3, 3, "_DT")) {
+        return BLPAPI_DATATYPE_DATE;
+    }
+    if (name.find("TIME") != std::string::npos) {
+        return BLPAPI_DATATYPE_DATETIME;
+    }
+    if (name.find("NAME") != std::string::npos ||
+        name.find("DES") != std::string::npos ||
+        name.find("STATUS") != std::string::npos) {
+        return BLPAPI_DATATYPE_STRING;
+    }
+    return BLPAPI_DATATYPE_FLOAT64;
+}
+
+// Add to `e` the field `name` with a value drawn from `random`, where
+// numeric fields move around the specified `price`.
+void addField(blpapi_Element     *e,
+              const std::string&  name,
+              double              price,
+              blpapi_Int64_t      ns,
+              Random             *random)
+{
+    int datatype = fieldType(name);
+    blpapi_Element *f = e->add(name.c_str(), datatype);
+    if ("FAKE_SEND_TIME" == name) {
+        f->setInt(monotonicNanoseconds(), datatype);
+        return;
+    }
+    switch (datatype) {
+      case BLPAPI_DATATYPE_BOOL:
+        f->setInt(0, datatype);
+        break;
+      case BLPAPI_DATATYPE_INT32:
+        f->setInt(100 * (1 + random->next() % 50), datatype);
+        break;
+      case BLPAPI_DATATYPE_INT64:
+        f->setInt(1000 * (1 + random->next() % 100000), datatype);
+        break;
+      case BLPAPI_DATATYPE_STRING: {
+        std::ostringstream ss;
+        ss << name << ' ' << random->next() % 1000;
+        f->setString(ss.str());
+      } break;
+      case BLPAPI_DATATYPE_DATE:
+        f->setDatetime(toDatetime(ns, BLPAPI_DATETIME_DATE_PART), datatype);
+        break;
+      case BLPAPI_DATATYPE_TIME:
+        f->setDatetime(toDatetime(ns, BLPAPI_DATETIME_TIMEMILLI_PART),
+                       datatype);
+        break;
+      case BLPAPI_DATATYPE_DATETIME:
+        f->setDatetime(toDatetime(ns,
+                                  BLPAPI_DATETIME_DATE_PART |
+                                  BLPAPI_DATETIME_TIMEMILLI_PART),
+                       datatype);
+        break;
+      default:
+        f->setFloat(price * (0.99 + 0.02 * random->uniform()));
+        break;
+    }
+}
+
+// Return the starting price of the security `name`.
+double basePrice(const std::string& name)
+{
+    return 10 + static_cast<double>(hashString(name) % 100000) / 100;
+}
+
+}  // close unnamed namespace
+
+                          // ========================
+                          // struct Message and Event
+                          // ========================
+
+struct blpapi_Message {
+    volatile int                          d_refs;
+    blpapi_Int64_t                        d_timeReceived;  // 0 if not kept
+    blpapi_Name                          *d_type;
+    std::string                           d_topic;
+    std::vector<blpapi_CorrelationId_t>   d_cids;
+    blpapi_Element                       *d_root;
+
+    blpapi_Message(const char *type, const std::string& topic)
+    : d_refs(1), d_timeReceived(0), d_type(intern(type)), d_topic(topic)
+    , d_root(new blpapi_Element(d_type, BLPAPI_DATATYPE_SEQUENCE, false))
+    {
+    }
+
+    ~blpapi_Message()
+    {
+        for (std::size_t i = 0; i < d_cids.size(); ++i) {
+            destroyCorrelationId(&d_cids[i]);
+        }
+        delete d_root;
+    }
+
+    void addCorrelationId(const blpapi_CorrelationId_t& cid)
+    {
+        d_cids.push_back(blpapi_CorrelationId_t());
+        copyCorrelationId(&d_cids.back(), cid);
+    }
+};
+
+struct blpapi_Event {
+    volatile int                     d_refs;
+    int                              d_type;
+    std::vector<blpapi_Message *>    d_messages;
+
+    explicit blpapi_Event(int type)
+    : d_refs(1), d_type(type)
+    {
+    }
+
+    ~blpapi_Event()
+    {
+        for (std::size_t i = 0; i < d_messages.size(); ++i) {
+            if (0 == release(&d_messages[i]->d_refs)) {
+                delete d_messages[i];
+            }
+        }
+    }
+
+    // Add a message of the specified `type` for `cid`, and return it.
+    blpapi_Message *add(const char                   *type,
+                        const blpapi_CorrelationId_t *cid,
+                        const std::string&            topic = std::string())
+    {
+        blpapi_Message *m = new blpapi_Message(type, topic);
+        if (cid) {
+            m->addCorrelationId(*cid);
+        }
+        d_messages.push_back(m);
+        return m;
+    }
+};
+
+struct blpapi_MessageIterator {
+    const blpapi_Event  *d_event;
+    std::size_t          d_next;
+};
+
+                        // ===========================
+                        // struct Identity and Request
+                        // ===========================
+
+struct blpapi_Identity {
+    volatile int d_refs;
+};
+
+struct blpapi_Service {
+    volatile int  d_refs;
+    std::string   d_name;
+};
+
+struct blpapi_Request {
+    std::string      d_service;
+    std::string      d_operation;
+    blpapi_Element  *d_root;
+
+    ~blpapi_Request()
+    {
+        delete d_root;
+    }
+};
+
+struct blpapi_SubscriptionList {
+    struct Entry {
+        std::string                d_topic;
+        blpapi_CorrelationId_t     d_cid;
+        std::vector<std::string>   d_fields;
+        std::vector<std::string>   d_options;
+    };
+    std::vector<Entry> d_entries;
+
+    ~blpapi_SubscriptionList()
+    {
+        for (std::size_t i = 0; i < d_entries.size(); ++i) {
+            destroyCorrelationId(&d_entries[i].d_cid);
+        }
+    }
+};
+
+struct blpapi_SessionOptions {
+    typedef std::pair<std::string, unsigned short> ServerAddress;
+
+    std::vector<ServerAddress> d_serverAddresses;
+    unsigned int               d_connectTimeout;
+    std::string                d_defaultServices;
+    std::string                d_defaultSubscriptionService;
+    std::string                d_defaultTopicPrefix;
+    bool                       d_allowMultipleCorrelators;
+    int                        d_clientMode;
+    int                        d_maxPendingRequests;
+    bool                       d_autoRestart;
+    int                        d_numStartAttempts;
+    std::string                d_authenticationOptions;
+    std::size_t                d_maxEventQueueSize;
+    float                      d_hiWaterMark;
+    float                      d_loWaterMark;
+    int                        d_keepAliveInactivityTime;
+    int                        d_keepAliveResponseTimeout;
+    bool                       d_keepAliveEnabled;
+    bool                       d_recordReceiveTimes;
+
+    blpapi_SessionOptions()
+    : d_serverAddresses(1, ServerAddress("127.0.0.1", 8194))
+    , d_connectTimeout(5000), d_defaultServices("//blp/mktdata")
+    , d_defaultSubscriptionService("//blp/mktdata")
+    , d_defaultTopicPrefix("/ticker/"), d_allowMultipleCorrelators(false)
+    , d_clientMode(BLPAPI_CLIENTMODE_AUTO), d_maxPendingRequests(1024)
+    , d_autoRestart(false), d_numStartAttempts(1)
+    , d_maxEventQueueSize(10000), d_hiWaterMark(0.75f)
+    , d_loWaterMark(0.5f), d_keepAliveInactivityTime(20000)
+    , d_keepAliveResponseTimeout(5000), d_keepAliveEnabled(true)
+    , d_recordReceiveTimes(false)
+    {
+    }
+};
+
+                               // ==============
+                               // struct Session
+                               // ==============
+
+struct blpapi_AbstractSession {
+    blpapi_Session *d_session;
+};
+
+namespace {
+
+// A subscription, and the state of its tick generator.
+struct Subscription {
+    std::string                 d_topic;
+    blpapi_CorrelationId_t      d_cid;
+    std::vector<std::string>    d_fields;
+    double                      d_price;
+    Random                      d_random;
+    blpapi_Int64_t              d_interval;   // ns, 0 for no pacing
+    blpapi_Int64_t              d_due;        // ns
+    long                        d_remaining;  // -1 for no limit
+
+    ~Subscription()
+    {
+        destroyCorrelationId(&d_cid);
+    }
+};
+
+typedef std::map<CorrelationKey, Subscription *> SubscriptionMap;
+
+}  // close unnamed namespace
+
+struct blpapi_Session {
+    blpapi_AbstractSession          d_abstract;
+    blpapi_SessionOptions           d_options;
+    blpapi_EventHandler_t           d_handler;
+    void                           *d_userData;
+    pthread_mutex_t                 d_lock;
+    pthread_cond_t                  d_cond;
+    pthread_t                       d_thread;
+    bool                            d_threadStarted;
+    bool                            d_started;
+    bool                            d_terminate;
+    std::deque<blpapi_Event *>      d_events;
+    std::map<std::string, blpapi_Service *> d_services;
+    SubscriptionMap                 d_subscriptions;
+    long                            d_tickRate;
+    long                            d_tickCount;
+    long                            d_messagesPerEvent;
+    unsigned long long              d_seed;
+    unsigned long long              d_tokens;
+
+    // Queue the specified `event` for dispatch.  The lock must be held.
+    void post(blpapi_Event *event)
+    {
+        d_events.push_back(event);
+        pthread_cond_broadcast(&d_cond);
+    }
+
+    void postLocked(blpapi_Event *event)
+    {
+        pthread_mutex_lock(&d_lock);
+        post(event);
+        pthread_mutex_unlock(&d_lock);
+    }
+};
+
+namespace {
+
+// Add to `event` a tick of the specified subscription `s`, stamped with
+// the time it was received if `recordTimes` is `true`.
+void addTick(blpapi_Event   *event,
+             Subscription   *s,
+             blpapi_Int64_t  ns,
+             bool            recordTimes)
+{
+    blpapi_Message *m = event->add("MarketDataEvents", &s->d_cid, s->d_topic);
+    if (recordTimes) {
+        m->d_timeReceived = monotonicNanoseconds();
+    }
+    m->d_root->add("MKTDATA_EVENT_TYPE", BLPAPI_DATATYPE_ENUMERATION)
+             ->setEnum("TRADE");
+    m->d_root->add("MKTDATA_EVENT_SUBTYPE", BLPAPI_DATATYPE_ENUMERATION)
+             ->setEnum("NEW");
+    s->d_price *= 1 + (s->d_random.uniform() - 0.5) / 1000;
+    for (std::size_t i = 0; i < s->d_fields.size(); ++i) {
+        addField(m->d_root, s->d_fields[i], s->d_price, ns, &s->d_random);
+    }
+}
+
+// Generate the ticks due by `now` into events queued on `session`, and
+// return the time the next tick is due, or -1 if none is.  The lock must
+// be held.
+blpapi_Int64_t generateTicks(blpapi_Session *session, blpapi_Int64_t now)
+{
+    blpapi_Int64_t next = -1;
+    const std::size_t messagesPerEvent =
+                       static_cast<std::size_t>(session->d_messagesPerEvent);
+    blpapi_Event *event = 0;
+    for (SubscriptionMap::iterator it = session->d_subscriptions.begin();
+         it != session->d_subscriptions.end();
+         ++it) {
+        Subscription *s = it->second;
+        // Each pass generates at most one tick per subscription, so that
+        // unpaced subscriptions take turns.
+        if (0 != s->d_remaining && s->d_due <= now) {
+            if (!event) {
+                event = new blpapi_Event(BLPAPI_EVENTTYPE_SUBSCRIPTION_DATA);
+            }
+            addTick(event,
+                    s,
+                    now,
+                    session->d_options.d_recordReceiveTimes);
+            if (s->d_remaining > 0) {
+                --s->d_remaining;
+            }
+            s->d_due = s->d_interval ? std::max(s->d_due + s->d_interval,
+                                                now - s->d_interval)
+                                     : now;
+            if (event->d_messages.size() >= messagesPerEvent) {
+                session->post(event);
+                event = 0;
+            }
+        }
+        if (0 != s->d_remaining && (next < 0 || s->d_due < next)) {
+            next = s->d_due;
+        }
+    }
+    if (event) {
+        session->post(event);
+    }
+    return next;
+}
+
+extern "C" void *dispatch(void *arg)
+{
+    blpapi_Session *session = static_cast<blpapi_Session *>(arg);
+    pthread_mutex_lock(&session->d_lock);
+    for (;;) {
+        if (!session->d_events.empty()) {
+            blpapi_Event *event = session->d_events.front();
+            session->d_events.pop_front();
+            pthread_mutex_unlock(&session->d_lock);
+            // The handler takes over the reference of the event.
+            session->d_handler(event, session, session->d_userData);
+            pthread_mutex_lock(&session->d_lock);
+            continue;
+        }
+        if (session->d_terminate) {
+            break;
+        }
+
+        blpapi_Int64_t now = nowNanoseconds();
+        blpapi_Int64_t next = generateTicks(session, now);
+        if (!session->d_events.empty()) {
+            continue;
+        }
+        if (next < 0) {
+            pthread_cond_wait(&session->d_cond, &session->d_lock);
+        } else if (next > now) {
+            struct timespec ts;
+            ts.tv_sec = static_cast<time_t>(next / 1000000000LL);
+            ts.tv_nsec = static_cast<long>(next % 1000000000LL);
+            pthread_cond_timedwait(&session->d_cond, &session->d_lock, &ts);
+        }
+    }
+    pthread_mutex_unlock(&session->d_lock);
+    return 0;
+}
+
+blpapi_Event *statusEvent(int type, const char *messageType)
+{
+    blpapi_Event *event = new blpapi_Event(type);
+    event->add(messageType, 0);
+    return event;
+}
+
+void addReason(blpapi_Element *e, const char *category, const char *text)
+{
+    blpapi_Element *reason = e->add("reason", BLPAPI_DATATYPE_SEQUENCE);
+    reason->add("source", BLPAPI_DATATYPE_STRING)->setString("fake");
+    reason->add("errorCode", BLPAPI_DATATYPE_INT32)
+          ->setInt(-1, BLPAPI_DATATYPE_INT32);
+    reason->add("category", BLPAPI_DATATYPE_STRING)->setString(category);
+    reason->add("description", BLPAPI_DATATYPE_STRING)->setString(text);
+}
+
+bool isInvalid(const std::string& security)
+{
+    return security.find("INVALID") != std::string::npos;
+}
+
+                            // ====================
+                            // namespace responses
+                            // ====================
+
+// Queue on `session` the `messages` of a response, each in its own event,
+// all but the last being partial responses.
+void postResponse(blpapi_Session                       *session,
+                  const std::vector<blpapi_Message *>&  messages)
+{
+    pthread_mutex_lock(&session->d_lock);
+    for (std::size_t i = 0; i < messages.size(); ++i) {
+        blpapi_Event *event = new blpapi_Event(
+                                    i + 1 < messages.size()
+                                        ? BLPAPI_EVENTTYPE_PARTIAL_RESPONSE
+                                        : BLPAPI_EVENTTYPE_RESPONSE);
+        event->d_messages.push_back(messages[i]);
+        session->post(event);
+    }
+    pthread_mutex_unlock(&session->d_lock);
+}
+
+void referenceData(std::vector<blpapi_Message *>  *messages,
+                   const blpapi_Request&           request,
+                   const blpapi_CorrelationId_t&   cid)
+{
+    static const std::size_t SECURITIES_PER_MESSAGE = 10;
+
+    std::vector<std::string> securities =
+                                 stringValues(request.d_root, "securities");
+    std::vector<std::string> fields = stringValues(request.d_root, "fields");
+    blpapi_Int64_t now = nowNanoseconds();
+    blpapi_Message *m = 0;
+    blpapi_Element *securityData = 0;
+    for (std::size_t i = 0; i < securities.size() || !m; ++i) {
+        if (!m || securityData->d_elements.size() == SECURITIES_PER_MESSAGE) {
+            m = new blpapi_Message("ReferenceDataResponse", std::string());
+            m->addCorrelationId(cid);
+            messages->push_back(m);
+            securityData = m->d_root->add("securityData",
+                                          BLPAPI_DATATYPE_SEQUENCE);
+            securityData->d_isArray = true;
+        }
+        if (i >= securities.size()) {
+            break;
+        }
+        blpapi_Element *sd = securityData->append();
+        sd->add("security", BLPAPI_DATATYPE_STRING)->setString(securities[i]);
+        sd->add("sequenceNumber", BLPAPI_DATATYPE_INT32)
+          ->setInt(static_cast<blpapi_Int64_t>(i), BLPAPI_DATATYPE_INT32);
+        if (isInvalid(securities[i])) {
+            blpapi_Element *error = sd->add("securityError",
+                                            BLPAPI_DATATYPE_SEQUENCE);
+            error->add("source", BLPAPI_DATATYPE_STRING)->setString("fake");
+            error->add("category", BLPAPI_DATATYPE_STRING)
+                 ->setString("BAD_SEC");
+            error->add("message", BLPAPI_DATATYPE_STRING)
+                 ->setString("Unknown/Invalid security");
+            continue;
+        }
+        sd->add("fieldExceptions", BLPAPI_DATATYPE_SEQUENCE)->d_isArray = true;
+        blpapi_Element *fd = sd->add("fieldData", BLPAPI_DATATYPE_SEQUENCE);
+        Random random(hashString(securities[i]));
+        for (std::size_t j = 0; j < fields.size(); ++j) {
+            addField(fd, fields[j], basePrice(securities[i]), now, &random);
+        }
+    }
+}
+
+void historicalData(std::vector<blpapi_Message *>  *messages,
+                    const blpapi_Request&           request,
+                    const blpapi_CorrelationId_t&   cid)
+{
+    static const blpapi_Int64_t DAY = 86400;
+    static const blpapi_Int64_t MAX_DAYS = 100000;
+
+    std::vector<std::string> securities =
+                                 stringValues(request.d_root, "securities");
+    std::vector<std::string> fields = stringValues(request.d_root, "fields");
+    blpapi_Int64_t end = datetimeValue(request.d_root, "endDate");
+    if (end < 0) {
+        end = nowNanoseconds() / 1000000000LL / DAY * DAY;
+    }
+    blpapi_Int64_t start = datetimeValue(request.d_root, "startDate");
+    if (start < 0 || start > end) {
+        start = end - 30 * DAY;
+    }
+    start = std::max(start, end - MAX_DAYS * DAY);
+
+    for (std::size_t i = 0; i < securities.size(); ++i) {
+        blpapi_Message *m = new blpapi_Message("HistoricalDataResponse",
+                                               std::string());
+        m->addCorrelationId(cid);
+        messages->push_back(m);
+        blpapi_Element *sd = m->d_root->add("securityData",
+                                            BLPAPI_DATATYPE_SEQUENCE);
+        sd->add("security", BLPAPI_DATATYPE_STRING)->setString(securities[i]);
+        sd->add("sequenceNumber", BLPAPI_DATATYPE_INT32)
+          ->setInt(static_cast<blpapi_Int64_t>(i), BLPAPI_DATATYPE_INT32);
+        if (isInvalid(securities[i])) {
+            blpapi_Element *error = sd->add("securityError",
+                                            BLPAPI_DATATYPE_SEQUENCE);
+            error->add("category", BLPAPI_DATATYPE_STRING)
+                 ->setString("BAD_SEC");
+            continue;
+        }
+        blpapi_Element *rows = sd->add("fieldData", BLPAPI_DATATYPE_SEQUENCE);
+        rows->d_isArray = true;
+        Random random(hashString(securities[i]));
+        double price = basePrice(securities[i]);
+        for (blpapi_Int64_t day = start; day <= end; day += DAY) {
+            blpapi_Element *row = rows->append();
+            row->add("date", BLPAPI_DATATYPE_DATE)
+               ->setDatetime(toDatetime(day * 1000000000LL,
+                                        BLPAPI_DATETIME_DATE_PART),
+                             BLPAPI_DATATYPE_DATE);
+            price *= 1 + (random.uniform() - 0.5) / 50;
+            for (std::size_t j = 0; j < fields.size(); ++j) {
+                addField(row, fields[j], price, day * 1000000000LL, &random);
+            }
+        }
+    }
+    if (securities.empty()) {
+        blpapi_Message *m = new blpapi_Message("HistoricalDataResponse",
+                                               std::string());
+        m->addCorrelationId(cid);
+        messages->push_back(m);
+    }
+}
+
+void intradayData(std::vector<blpapi_Message *>  *messages,
+                  const blpapi_Request&           request,
+                  const blpapi_CorrelationId_t&   cid,
+                  bool                            bars)
+{
+    static const blpapi_Int64_t MAX_ROWS = 100000;
+
+    std::string security = stringValue(request.d_root, "security");
+    blpapi_Int64_t end = datetimeValue(request.d_root, "endDateTime");
+    if (end < 0) {
+        end = nowNanoseconds() / 1000000000LL;
+    }
+    blpapi_Int64_t start = datetimeValue(request.d_root, "startDateTime");
+    if (start < 0 || start > end) {
+        start = end - 3600;
+    }
+    blpapi_Int64_t step = 1;
+    if (bars) {
+        std::string interval = stringValue(request.d_root, "interval");
+        step = 60 * std::max(1L, std::strtol(interval.c_str(), 0, 10));
+    }
+    start = std::max(start, end - MAX_ROWS * step);
+
+    std::vector<std::string> types = stringValues(request.d_root,
+                                                  "eventTypes");
+    std::string type = stringValue(request.d_root, "eventType");
+    if (!type.empty()) {
+        types.push_back(type);
+    }
+    if (types.empty()) {
+        types.push_back("TRADE");
+    }
+
+    blpapi_Message *m = new blpapi_Message(bars ? "IntradayBarResponse"
+                                                : "IntradayTickResponse",
+                                           std::string());
+    m->addCorrelationId(cid);
+    messages->push_back(m);
+    if (isInvalid(security)) {
+        blpapi_Element *error = m->d_root->add("responseError",
+                                               BLPAPI_DATATYPE_SEQUENCE);
+        error->add("category", BLPAPI_DATATYPE_STRING)->setString("BAD_SEC");
+        return;
+    }
+
+    blpapi_Element *data = m->d_root->add(bars ? "barData" : "tickData",
+                                          BLPAPI_DATATYPE_SEQUENCE);
+    blpapi_Element *rows = data->add(bars ? "barTickData" : "tickData",
+                                     BLPAPI_DATATYPE_SEQUENCE);
+    rows->d_isArray = true;
+    Random random(hashString(security));
+    double price = basePrice(security);
+    const int parts = BLPAPI_DATETIME_DATE_PART | BLPAPI_DATETIME_TIME_PART;
+    std::size_t n = 0;
+    for (blpapi_Int64_t t = start; t < end; t += step, ++n) {
+        blpapi_Element *row = rows->append();
+        row->add("time", BLPAPI_DATATYPE_DATETIME)
+           ->setDatetime(toDatetime(t * 1000000000LL, parts),
+                         BLPAPI_DATATYPE_DATETIME);
+        price *= 1 + (random.uniform() - 0.5) / 1000;
+        if (bars) {
+            const char *names[] = { "open", "high", "low", "close" };
+            const double moves[] = { 1, 1.001, 0.999, 1 };
+            for (int i = 0; i < 4; ++i) {
+                row->add(names[i], BLPAPI_DATATYPE_FLOAT64)
+                   ->setFloat(price * moves[i]);
+            }
+            row->add("volume", BLPAPI_DATATYPE_INT64)
+               ->setInt(100 * (1 + random.next() % 1000),
+                        BLPAPI_DATATYPE_INT64);
+            row->add("numEvents", BLPAPI_DATATYPE_INT32)
+               ->setInt(1 + random.next() % 100, BLPAPI_DATATYPE_INT32);
+            row->add("value", BLPAPI_DATATYPE_FLOAT64)->setFloat(price * 100);
+        } else {
+            row->add("type", BLPAPI_DATATYPE_STRING)
+               ->setString(types[n % types.size()]);
+            row->add("value", BLPAPI_DATATYPE_FLOAT64)->setFloat(price);
+            row->add("size", BLPAPI_DATATYPE_INT32)
+               ->setInt(100 * (1 + random.next() % 50), BLPAPI_DATATYPE_INT32);
+        }
+    }
+}
+
+int invalidArg(const char *what)
+{
+    return fail(BLPAPI_ERROR_ILLEGAL_ARG, what);
+}
+
+}  // close unnamed namespace
+
+extern "C" {
+
+                              // ===============
+                              // Error and Names
+                              // ===============
+
+const char *blpapi_getLastErrorDescription(int)
+{
+    return t_lastError;
+}
+
+blpapi_Name_t *blpapi_Name_create(const char *nameString)
+{
+    return intern(nameString);
+}
+
+void blpapi_Name_destroy(blpapi_Name_t *)
+{
+    // Names are interned for the life of the process.
+}
+
+blpapi_Name_t *blpapi_Name_duplicate(const blpapi_Name_t *src)
+{
+    return const_cast<blpapi_Name_t *>(src);
+}
+
+blpapi_Name_t *blpapi_Name_findName(const char *nameString)
+{
+    return intern(nameString, false);
+}
+
+size_t blpapi_Name_length(const blpapi_Name_t *name)
+{
+    return name->d_string.size();
+}
+
+const char *blpapi_Name_string(const blpapi_Name_t *name)
+{
+    return name->d_string.c_str();
+}
+
+                                 // ========
+                                 // Elements
+                                 // ========
+
+blpapi_Name_t *blpapi_Element_name(const blpapi_Element_t *element)
+{
+    return element->d_name;
+}
+
+int blpapi_Element_datatype(const blpapi_Element_t *element)
+{
+    return element->d_datatype ? element->d_datatype
+                               : BLPAPI_DATATYPE_STRING;
+}
+
+int blpapi_Element_isComplexType(const blpapi_Element_t *element)
+{
+    return element->isComplex();
+}
+
+int blpapi_Element_isArray(const blpapi_Element_t *element)
+{
+    return element->d_isArray;
+}
+
+int blpapi_Element_isNull(const blpapi_Element_t *element)
+{
+    return !element->isComplex() && !element->d_isArray &&
+           element->d_values.empty();
+}
+
+size_t blpapi_Element_numValues(const blpapi_Element_t *element)
+{
+    return element->numValues();
+}
+
+size_t blpapi_Element_numElements(const blpapi_Element_t *element)
+{
+    return element->isComplex() && !element->d_isArray
+               ? element->d_elements.size() : 0;
+}
+
+int blpapi_Element_print(const blpapi_Element_t *element,
+                         blpapi_StreamWriter_t   streamWriter,
+                         void                   *stream,
+                         int                     level,
+                         int                     spacesPerLevel)
+{
+    std::ostringstream ss;
+    printElement(ss, element, level, spacesPerLevel);
+    std::string s = ss.str();
+    return streamWriter(s.data(), static_cast<int>(s.size()), stream);
+}
+
+int blpapi_Element_getElementAt(const blpapi_Element_t  *element,
+                                blpapi_Element_t       **result,
+                                size_t                   position)
+{
+    if (!element->isComplex() || element->d_isArray ||
+        position >= element->d_elements.size()) {
+        return fail(BLPAPI_ERROR_INDEX_OUT_OF_RANGE, "Index out of range");
+    }
+    *result = element->d_elements[position];
+    return 0;
+}
+
+int blpapi_Element_getElement(const blpapi_Element_t  *element,
+                              blpapi_Element_t       **result,
+                              const char              *nameString,
+                              const blpapi_Name_t     *name)
+{
+    blpapi_Element *e = const_cast<blpapi_Element *>(element);
+    if (!name) {
+        name = intern(nameString, e->d_writable);
+    }
+    blpapi_Element *se = name ? e->find(name) : 0;
+    if (!se && e->d_writable && !e->d_isArray &&
+        (!e->d_datatype || e->isComplex())) {
+        e->d_datatype = BLPAPI_DATATYPE_SEQUENCE;
+        se = e->add(name->d_string.c_str(), 0);
+    }
+    if (!se) {
+        return fail(BLPAPI_ERROR_ITEM_NOT_FOUND,
+                    std::string("Element not found: ") +
+                    (name ? name->d_string.c_str() : nameString));
+    }
+    *result = se;
+    return 0;
+}
+
+int blpapi_Element_hasElementEx(const blpapi_Element_t *element,
+                                const char             *nameString,
+                                const blpapi_Name_t    *name,
+                                int                     excludeNullElements,
+                                int)
+{
+    if (!name) {
+        name = intern(nameString, false);
+    }
+    const blpapi_Element *se = name ? element->find(name) : 0;
+    return se && !(excludeNullElements && blpapi_Element_isNull(se));
+}
+
+int blpapi_Element_hasElement(const blpapi_Element_t *element,
+                              const char             *nameString,
+                              const blpapi_Name_t    *name)
+{
+    return blpapi_Element_hasElementEx(element, nameString, name, 0, 0);
+}
+
+int blpapi_Element_appendElement(blpapi_Element_t  *element,
+                                 blpapi_Element_t **appendedElement)
+{
+    if (!element->d_writable ||
+        (element->d_datatype && !element->isComplex())) {
+        return fail(BLPAPI_ERROR_UNSUPPORTED_OPERATION,
+                    "Element is not an array of sequences");
+    }
+    *appendedElement = element->append();
+    return 0;
+}
+
+#define FAKE_GET_VALUE(element, index)                                      \
+    if (index >= element->d_values.size()) {                                \
+        return fail(BLPAPI_ERROR_INDEX_OUT_OF_RANGE, "Index out of range"); \
+    }                                                                       \
+    const FakeValue& v = element->d_values[index];
+
+#define FAKE_CONVERSION_ERROR                                               \
+    fail(BLPAPI_ERROR_INVALID_CONVERSION, "Invalid conversion")
+
+int blpapi_Element_getValueAsBool(const blpapi_Element_t *element,
+                                  blpapi_Bool_t          *buffer,
+                                  size_t                  index)
+{
+    FAKE_GET_VALUE(element, index)
+    switch (element->d_datatype) {
+      case BLPAPI_DATATYPE_BOOL:
+      case BLPAPI_DATATYPE_BYTE:
+      case BLPAPI_DATATYPE_INT32:
+      case BLPAPI_DATATYPE_INT64:
+        *buffer = v.d_int ? 1 : 0;
+        return 0;
+    }
+    return FAKE_CONVERSION_ERROR;
+}
+
+int blpapi_Element_getValueAsChar(const blpapi_Element_t *element,
+                                  blpapi_Char_t          *buffer,
+                                  size_t                  index)
+{
+    FAKE_GET_VALUE(element, index)
+    if (BLPAPI_DATATYPE_CHAR != element->d_datatype) {
+        return FAKE_CONVERSION_ERROR;
+    }
+    *buffer = static_cast<blpapi_Char_t>(v.d_int);
+    return 0;
+}
+
+int blpapi_Element_getValueAsInt64(const blpapi_Element_t *element,
+                                   blpapi_Int64_t         *buffer,
+                                   size_t                  index)
+{
+    FAKE_GET_VALUE(element, index)
+    switch (element->d_datatype) {
+      case BLPAPI_DATATYPE_BOOL:
+      case BLPAPI_DATATYPE_CHAR:
+      case BLPAPI_DATATYPE_BYTE:
+      case BLPAPI_DATATYPE_INT32:
+      case BLPAPI_DATATYPE_INT64:
+        *buffer = v.d_int;
+        return 0;
+    }
+    return FAKE_CONVERSION_ERROR;
+}
+
+int blpapi_Element_getValueAsInt32(const blpapi_Element_t *element,
+                                   blpapi_Int32_t         *buffer,
+                                   size_t                  index)
+{
+    blpapi_Int64_t value;
+    int rc = blpapi_Element_getValueAsInt64(element, &value, index);
+    if (!rc) {
+        *buffer = static_cast<blpapi_Int32_t>(value);
+    }
+    return rc;
+}
+
+int blpapi_Element_getValueAsFloat64(const blpapi_Element_t *element,
+                                     blpapi_Float64_t       *buffer,
+                                     size_t                  index)
+{
+    FAKE_GET_VALUE(element, index)
+    switch (element->d_datatype) {
+      case BLPAPI_DATATYPE_FLOAT32:
+      case BLPAPI_DATATYPE_FLOAT64:
+        *buffer = v.d_float;
+        return 0;
+      case BLPAPI_DATATYPE_BOOL:
+      case BLPAPI_DATATYPE_CHAR:
+      case BLPAPI_DATATYPE_BYTE:
+      case BLPAPI_DATATYPE_INT32:
+      case BLPAPI_DATATYPE_INT64:
+        *buffer = static_cast<blpapi_Float64_t>(v.d_int);
+        return 0;
+    }
+    return FAKE_CONVERSION_ERROR;
+}
+
+int blpapi_Element_getValueAsFloat32(const blpapi_Element_t *element,
+                                     blpapi_Float32_t       *buffer,
+                                     size_t                  index)
+{
+    blpapi_Float64_t value;
+    int rc = blpapi_Element_getValueAsFloat64(element, &value, index);
+    if (!rc) {
+        *buffer = static_cast<blpapi_Float32_t>(value);
+    }
+    return rc;
+}
+
+int blpapi_Element_getValueAsString(const blpapi_Element_t  *element,
+                                    const char             **buffer,
+                                    size_t                   index)
+{
+    FAKE_GET_VALUE(element, index)
+    (void)v;
+    *buffer = valueString(element, index).c_str();
+    return 0;
+}
+
+int blpapi_Element_getValueAsName(const blpapi_Element_t  *element,
+                                  blpapi_Name_t          **buffer,
+                                  size_t                   index)
+{
+    FAKE_GET_VALUE(element, index)
+    switch (element->d_datatype) {
+      case BLPAPI_DATATYPE_ENUMERATION:
+        *buffer = v.d_name;
+        return 0;
+      case BLPAPI_DATATYPE_STRING:
+        *buffer = intern(v.d_string.c_str());
+        return 0;
+    }
+    return FAKE_CONVERSION_ERROR;
+}
+
+int blpapi_Element_getValueAsHighPrecisionDatetime(
+                                    const blpapi_Element_t         *element,
+                                    blpapi_HighPrecisionDatetime_t *buffer,
+                                    size_t                          index)
+{
+    FAKE_GET_VALUE(element, index)
+    switch (element->d_datatype) {
+      case BLPAPI_DATATYPE_DATE:
+      case BLPAPI_DATATYPE_TIME:
+      case BLPAPI_DATATYPE_DATETIME:
+        *buffer = v.d_datetime;
+        return 0;
+    }
+    return FAKE_CONVERSION_ERROR;
+}
+
+int blpapi_Element_getValueAsElement(const blpapi_Element_t  *element,
+                                     blpapi_Element_t       **buffer,
+                                     size_t                   index)
+{
+    if (!element->isComplex()) {
+        return FAKE_CONVERSION_ERROR;
+    }
+    if (!element->d_isArray) {
+        if (index) {
+            return fail(BLPAPI_ERROR_INDEX_OUT_OF_RANGE,
+                        "Index out of range");
+        }
+        *buffer = const_cast<blpapi_Element_t *>(element);
+        return 0;
+    }
+    if (index >= element->d_elements.size()) {
+        return fail(BLPAPI_ERROR_INDEX_OUT_OF_RANGE, "Index out of range");
+    }
+    *buffer = element->d_elements[index];
+    return 0;
+}
+
+#undef FAKE_GET_VALUE
+#undef FAKE_CONVERSION_ERROR
+
+#define FAKE_SET_VALUE(element, index, datatype)                            \
+    if (!element->d_writable) {                                             \
+        return fail(BLPAPI_ERROR_ILLEGAL_ACCESS, "Element is read-only");   \
+    }                                                                       \
+    FakeValue *v = element->slot(index, datatype);                          \
+    if (!v) {                                                               \
+        return fail(BLPAPI_ERROR_INDEX_OUT_OF_RANGE, "Index out of range"); \
+    }
+
+int blpapi_Element_setValueBool(blpapi_Element_t *element,
+                                blpapi_Bool_t     value,
+                                size_t            index)
+{
+    FAKE_SET_VALUE(element, index, BLPAPI_DATATYPE_BOOL)
+    v->d_int = value ? 1 : 0;
+    return 0;
+}
+
+int blpapi_Element_setValueInt32(blpapi_Element_t *element,
+                                 blpapi_Int32_t    value,
+                                 size_t            index)
+{
+    FAKE_SET_VALUE(element, index, BLPAPI_DATATYPE_INT32)
+    v->d_int = value;
+    return 0;
+}
+
+int blpapi_Element_setValueInt64(blpapi_Element_t *element,
+                                 blpapi_Int64_t    value,
+                                 size_t            index)
+{
+    FAKE_SET_VALUE(element, index, BLPAPI_DATATYPE_INT64)
+    v->d_int = value;
+    return 0;
+}
+
+int blpapi_Element_setValueFloat64(blpapi_Element_t *element,
+                                   blpapi_Float64_t  value,
+                                   size_t            index)
+{
+    FAKE_SET_VALUE(element, index, BLPAPI_DATATYPE_FLOAT64)
+    v->d_float = value;
+    return 0;
+}
+
+int blpapi_Element_setValueString(blpapi_Element_t *element,
+                                  const char       *value,
+                                  size_t            index)
+{
+    FAKE_SET_VALUE(element, index, BLPAPI_DATATYPE_STRING)
+    v->d_string = value;
+    return 0;
+}
+
+int blpapi_Element_setValueHighPrecisionDatetime(
+                              blpapi_Element_t                     *element,
+                              const blpapi_HighPrecisionDatetime_t *value,
+                              size_t                                index)
+{
+    FAKE_SET_VALUE(element, index, BLPAPI_DATATYPE_DATETIME)
+    v->d_datetime = *value;
+    return 0;
+}
+
+#undef FAKE_SET_VALUE
+
+int blpapi_Element_setElementString(blpapi_Element_t    *element,
+                                    const char          *nameString,
+                                    const blpapi_Name_t *name,
+                                    const char          *value)
+{
+    blpapi_Element_t *se;
+    int rc = blpapi_Element_getElement(element, &se, nameString, name);
+    return rc ? rc : blpapi_Element_setValueString(se, value, 0);
+}
+
+                            // ===================
+                            // Events and Messages
+                            // ===================
+
+int blpapi_Event_eventType(const blpapi_Event_t *event)
+{
+    return event->d_type;
+}
+
+int blpapi_Event_addRef(const blpapi_Event_t *event)
+{
+    addRef(&const_cast<blpapi_Event_t *>(event)->d_refs);
+    return 0;
+}
+
+int blpapi_Event_release(const blpapi_Event_t *event)
+{
+    if (event && 0 == release(&const_cast<blpapi_Event_t *>(event)->d_refs)) {
+        delete event;
+    }
+    return 0;
+}
+
+blpapi_MessageIterator_t *blpapi_MessageIterator_create(
+                                                   const blpapi_Event_t *event)
+{
+    blpapi_MessageIterator_t *it = new blpapi_MessageIterator_t;
+    it->d_event = event;
+    it->d_next = 0;
+    blpapi_Event_addRef(event);
+    return it;
+}
+
+void blpapi_MessageIterator_destroy(blpapi_MessageIterator_t *iterator)
+{
+    blpapi_Event_release(iterator->d_event);
+    delete iterator;
+}
+
+int blpapi_MessageIterator_next(blpapi_MessageIterator_t  *iterator,
+                                blpapi_Message_t         **result)
+{
+    if (iterator->d_next >= iterator->d_event->d_messages.size()) {
+        return 1;
+    }
+    *result = iterator->d_event->d_messages[iterator->d_next++];
+    return 0;
+}
+
+int blpapi_Message_addRef(const blpapi_Message_t *message)
+{
+    addRef(&const_cast<blpapi_Message_t *>(message)->d_refs);
+    return 0;
+}
+
+int blpapi_Message_release(const blpapi_Message_t *message)
+{
+    if (0 == release(&const_cast<blpapi_Message_t *>(message)->d_refs)) {
+        delete message;
+    }
+    return 0;
+}
+
+blpapi_Name_t *blpapi_Message_messageType(const blpapi_Message_t *message)
+{
+    return message->d_type;
+}
+
+const char *blpapi_Message_topicName(const blpapi_Message_t *message)
+{
+    return message->d_topic.c_str();
+}
+
+int blpapi_Message_timeReceived(const blpapi_Message_t *message,
+                                blpapi_TimePoint_t     *timeReceived)
+{
+    if (!message->d_timeReceived) {
+        return fail(BLPAPI_ERROR_ILLEGAL_STATE, "Time received not recorded");
+    }
+    timeReceived->d_value = message->d_timeReceived;
+    return 0;
+}
+
+int blpapi_Message_numCorrelationIds(const blpapi_Message_t *message)
+{
+    return static_cast<int>(message->d_cids.size());
+}
+
+blpapi_CorrelationId_t blpapi_Message_correlationId(
+                                           const blpapi_Message_t *message,
+                                           size_t                  index)
+{
+    blpapi_CorrelationId_t cid;
+    if (index < message->d_cids.size()) {
+        copyCorrelationId(&cid, message->d_cids[index]);
+    } else {
+        std::memset(&cid, 0, sizeof(cid));
+        cid.size = sizeof(cid);
+    }
+    return cid;
+}
+
+blpapi_Element_t *blpapi_Message_elements(const blpapi_Message_t *message)
+{
+    return message->d_root;
+}
+
+                            // ====================
+                            // Identity and Request
+                            // ====================
+
+int blpapi_Identity_addRef(blpapi_Identity_t *handle)
+{
+    if (handle) {
+        addRef(&handle->d_refs);
+    }
+    return 0;
+}
+
+void blpapi_Identity_release(blpapi_Identity_t *handle)
+{
+    if (handle && 0 == release(&handle->d_refs)) {
+        delete handle;
+    }
+}
+
+blpapi_Element_t *blpapi_Request_elements(blpapi_Request_t *request)
+{
+    return request->d_root;
+}
+
+void blpapi_Request_destroy(blpapi_Request_t *request)
+{
+    delete request;
+}
+
+int blpapi_Service_addRef(blpapi_Service_t *service)
+{
+    addRef(&service->d_refs);
+    return 0;
+}
+
+void blpapi_Service_release(blpapi_Service_t *service)
+{
+    if (0 == release(&service->d_refs)) {
+        delete service;
+    }
+}
+
+int blpapi_Service_createRequest(blpapi_Service_t  *service,
+                                 blpapi_Request_t **request,
+                                 const char        *operation)
+{
+    static const char *const REFDATA_OPERATIONS[] = {
+        "ReferenceDataRequest",
+        "HistoricalDataRequest",
+        "IntradayTickRequest",
+        "IntradayBarRequest"
+    };
+
+    bool found = false;
+    if ("//blp/refdata" == service->d_name) {
+        for (std::size_t i = 0; i < 4; ++i) {
+            found = found || 0 == std::strcmp(operation,
+                                              REFDATA_OPERATIONS[i]);
+        }
+    }
+    if (!found) {
+        return fail(BLPAPI_ERROR_ITEM_NOT_FOUND,
+                    std::string("Unknown operation: ") + operation);
+    }
+    blpapi_Request_t *r = new blpapi_Request_t;
+    r->d_service = service->d_name;
+    r->d_operation = operation;
+    r->d_root = new blpapi_Element(intern(operation),
+                                   BLPAPI_DATATYPE_SEQUENCE,
+                                   true);
+    *request = r;
+    return 0;
+}
+
+int blpapi_Service_createAuthorizationRequest(blpapi_Service_t  *service,
+                                              blpapi_Request_t **request,
+                                              const char        *operation)
+{
+    if ("//blp/apiauth" != service->d_name ||
+        0 != std::strcmp(operation, "AuthorizationRequest")) {
+        return fail(BLPAPI_ERROR_ITEM_NOT_FOUND,
+                    std::string("Unknown operation: ") + operation);
+    }
+    blpapi_Request_t *r = new blpapi_Request_t;
+    r->d_service = service->d_name;
+    r->d_operation = operation;
+    r->d_root = new blpapi_Element(intern(operation),
+                                   BLPAPI_DATATYPE_SEQUENCE,
+                                   true);
+    *request = r;
+    return 0;
+}
+
+                         // =========================
+                         // Subscription Lists
+                         // =========================
+
+blpapi_SubscriptionList_t *blpapi_SubscriptionList_create(void)
+{
+    return new blpapi_SubscriptionList_t;
+}
+
+void blpapi_SubscriptionList_destroy(blpapi_SubscriptionList_t *list)
+{
+    delete list;
+}
+
+int blpapi_SubscriptionList_add(blpapi_SubscriptionList_t     *list,
+                                const char                    *subscription,
+                                const blpapi_CorrelationId_t  *correlationId,
+                                const char                   **fields,
+                                const char                   **options,
+                                size_t                         numfields,
+                                size_t                         numOptions)
+{
+    blpapi_SubscriptionList::Entry entry;
+    std::string topic(subscription);
+    std::string query;
+    std::string::size_type q = topic.find('?');
+    if (q != std::string::npos) {
+        query = topic.substr(q + 1);
+        topic.erase(q);
+    }
+    entry.d_topic = topic;
+
+    std::vector<std::string> lists;
+    for (size_t i = 0; i < numfields; ++i) {
+        lists.push_back(std::string("fields=") + fields[i]);
+    }
+    for (size_t i = 0; i < numOptions; ++i) {
+        lists.push_back(options[i]);
+    }
+    lists.push_back(query);
+    for (std::size_t i = 0; i < lists.size(); ++i) {
+        // Options are separated by '&', and fields by ','.
+        std::istringstream os(lists[i]);
+        std::string option;
+        while (std::getline(os, option, '&')) {
+            if (0 == option.find("fields=")) {
+                std::istringstream fs(option.substr(7));
+                std::string field;
+                while (std::getline(fs, field, ',')) {
+                    if (!field.empty()) {
+                        entry.d_fields.push_back(field);
+                    }
+                }
+            } else if (!option.empty()) {
+                entry.d_options.push_back(option);
+            }
+        }
+    }
+
+    list->d_entries.push_back(entry);
+    copyCorrelationId(&list->d_entries.back().d_cid, *correlationId);
+    return 0;
+}
+
+                                  // =====
+                                  // Times
+                                  // =====
+
+// Time points are nanoseconds of the monotonic clock.
+int blpapi_HighResolutionClock_now(blpapi_TimePoint_t *timePoint)
+{
+    timePoint->d_value = monotonicNanoseconds();
+    return 0;
+}
+
+long long blpapi_TimePointUtil_nanosecondsBetween(
+                                              const blpapi_TimePoint_t *start,
+                                              const blpapi_TimePoint_t *end)
+{
+    return end->d_value - start->d_value;
+}
+
+                             // ===============
+                             // Session Options
+                             // ===============
+
+blpapi_SessionOptions_t *blpapi_SessionOptions_create(void)
+{
+    return new blpapi_SessionOptions_t;
+}
+
+blpapi_SessionOptions_t *blpapi_SessionOptions_duplicate(
+                                        const blpapi_SessionOptions_t *options)
+{
+    return new blpapi_SessionOptions_t(*options);
+}
+
+void blpapi_SessionOptions_destroy(blpapi_SessionOptions_t *options)
+{
+    delete options;
+}
+
+int blpapi_SessionOptions_setServerHost(blpapi_SessionOptions_t *options,
+                                        const char              *serverHost)
+{
+    options->d_serverAddresses[0].first = serverHost;
+    return 0;
+}
+
+int blpapi_SessionOptions_setServerPort(blpapi_SessionOptions_t *options,
+                                        unsigned short           serverPort)
+{
+    options->d_serverAddresses[0].second = serverPort;
+    return 0;
+}
+
+int blpapi_SessionOptions_setServerAddress(blpapi_SessionOptions_t *options,
+                                           const char              *serverHost,
+                                           unsigned short           serverPort,
+                                           size_t                   index)
+{
+    std::vector<blpapi_SessionOptions::ServerAddress>& addresses =
+                                                  options->d_serverAddresses;
+    if (index > addresses.size()) {
+        return invalidArg("Invalid server address index");
+    }
+    if (index == addresses.size()) {
+        addresses.push_back(blpapi_SessionOptions::ServerAddress());
+    }
+    addresses[index].first = serverHost;
+    addresses[index].second = serverPort;
+    return 0;
+}
+
+int blpapi_SessionOptions_removeServerAddress(
+                                             blpapi_SessionOptions_t *options,
+                                             size_t                   index)
+{
+    if (index >= options->d_serverAddresses.size() ||
+        1 == options->d_serverAddresses.size()) {
+        return invalidArg("Invalid server address index");
+    }
+    options->d_serverAddresses.erase(options->d_serverAddresses.begin() +
+                                     index);
+    return 0;
+}
+
+int blpapi_SessionOptions_setConnectTimeout(
+                                      blpapi_SessionOptions_t *options,
+                                      unsigned int             timeoutMsecs)
+{
+    if (timeoutMsecs < 1 || timeoutMsecs > 120000) {
+        return invalidArg("Invalid connect timeout");
+    }
+    options->d_connectTimeout = timeoutMsecs;
+    return 0;
+}
+
+int blpapi_SessionOptions_setDefaultServices(
+                                      blpapi_SessionOptions_t *options,
+                                      const char              *defaultServices)
+{
+    options->d_defaultServices = defaultServices;
+    return 0;
+}
+
+int blpapi_SessionOptions_setDefaultSubscriptionService(
+                                    blpapi_SessionOptions_t *options,
+                                    const char              *serviceIdentifier)
+{
+    if (0 != std::strncmp(serviceIdentifier, "//", 2)) {
+        return invalidArg("Invalid service identifier");
+    }
+    options->d_defaultSubscriptionService = serviceIdentifier;
+    return 0;
+}
+
+void blpapi_SessionOptions_setDefaultTopicPrefix(
+                                             blpapi_SessionOptions_t *options,
+                                             const char              *prefix)
+{
+    options->d_defaultTopicPrefix = prefix;
+}
+
+void blpapi_SessionOptions_setAllowMultipleCorrelatorsPerMsg(
+                                             blpapi_SessionOptions_t *options,
+                                             int                      allow)
+{
+    options->d_allowMultipleCorrelators = allow != 0;
+}
+
+void blpapi_SessionOptions_setClientMode(blpapi_SessionOptions_t *options,
+                                         int                      clientMode)
+{
+    options->d_clientMode = clientMode & ~BLPAPI_CLIENTMODE_COMPAT_33X;
+}
+
+void blpapi_SessionOptions_setMaxPendingRequests(
+                                     blpapi_SessionOptions_t *options,
+                                     int                      maxPending)
+{
+    options->d_maxPendingRequests = maxPending;
+}
+
+void blpapi_SessionOptions_setAutoRestartOnDisconnection(
+                                             blpapi_SessionOptions_t *options,
+                                             int                      restart)
+{
+    options->d_autoRestart = restart != 0;
+}
+
+void blpapi_SessionOptions_setNumStartAttempts(
+                                             blpapi_SessionOptions_t *options,
+                                             int                      attempts)
+{
+    options->d_numStartAttempts = attempts;
+}
+
+void blpapi_SessionOptions_setAuthenticationOptions(
+                                          blpapi_SessionOptions_t *options,
+                                          const char              *authOptions)
+{
+    options->d_authenticationOptions = authOptions;
+}
+
+void blpapi_SessionOptions_setMaxEventQueueSize(
+                                    blpapi_SessionOptions_t *options,
+                                    size_t                   maxEventQueueSize)
+{
+    options->d_maxEventQueueSize = maxEventQueueSize;
+}
+
+int blpapi_SessionOptions_setSlowConsumerWarningHiWaterMark(
+                                          blpapi_SessionOptions_t *options,
+                                          float                    hiWaterMark)
+{
+    if (!(hiWaterMark > 0 && hiWaterMark <= 1) ||
+        hiWaterMark <= options->d_loWaterMark) {
+        return invalidArg("Invalid high water mark");
+    }
+    options->d_hiWaterMark = hiWaterMark;
+    return 0;
+}
+
+int blpapi_SessionOptions_setDefaultKeepAliveInactivityTime(
+                                        blpapi_SessionOptions_t *options,
+                                        int                      inactivity)
+{
+    if (inactivity < 0) {
+        return invalidArg("Invalid keep alive inactivity time");
+    }
+    options->d_keepAliveInactivityTime = inactivity;
+    return 0;
+}
+
+int blpapi_SessionOptions_setDefaultKeepAliveResponseTimeout(
+                                        blpapi_SessionOptions_t *options,
+                                        int                      timeout)
+{
+    if (timeout < 0) {
+        return invalidArg("Invalid keep alive response timeout");
+    }
+    options->d_keepAliveResponseTimeout = timeout;
+    return 0;
+}
+
+int blpapi_SessionOptions_setKeepAliveEnabled(
+                                             blpapi_SessionOptions_t *options,
+                                             int                      enabled)
+{
+    options->d_keepAliveEnabled = enabled != 0;
+    return 0;
+}
+
+void blpapi_SessionOptions_setRecordSubscriptionDataReceiveTimes(
+                                         blpapi_SessionOptions_t *options,
+                                         int                      shouldRecord)
+{
+    options->d_recordReceiveTimes = shouldRecord != 0;
+}
+
+int blpapi_SessionOptions_setSlowConsumerWarningLoWaterMark(
+                                          blpapi_SessionOptions_t *options,
+                                          float                    loWaterMark)
+{
+    if (!(loWaterMark >= 0 && loWaterMark < 1) ||
+        loWaterMark >= options->d_hiWaterMark) {
+        return invalidArg("Invalid low water mark");
+    }
+    options->d_loWaterMark = loWaterMark;
+    return 0;
+}
+
+                                 // ========
+                                 // Sessions
+                                 // ========
+
+blpapi_Session_t *blpapi_Session_create(blpapi_SessionOptions_t  *options,
+                                        blpapi_EventHandler_t     handler,
+                                        blpapi_EventDispatcher_t *,
+                                        void                     *userData)
+{
+    if (!handler) {
+        // Only asynchronous sessions are supported.
+        fail(BLPAPI_ERROR_UNSUPPORTED_OPERATION,
+             "The fake session requires an event handler");
+        return 0;
+    }
+    blpapi_Session_t *session = new blpapi_Session_t;
+    session->d_abstract.d_session = session;
+    if (options) {
+        session->d_options = *options;
+    }
+    session->d_handler = handler;
+    session->d_userData = userData;
+    pthread_mutex_init(&session->d_lock, 0);
+    pthread_cond_init(&session->d_cond, 0);
+    session->d_threadStarted = false;
+    session->d_started = false;
+    session->d_terminate = false;
+    session->d_tickRate = envValue("BLPAPI_FAKE_TICK_RATE", 10);
+    session->d_tickCount = envValue("BLPAPI_FAKE_TICK_COUNT", 0);
+    session->d_messagesPerEvent =
+                       std::max(1L, envValue("BLPAPI_FAKE_MESSAGES_PER_EVENT",
+                                             1));
+    session->d_seed = envValue("BLPAPI_FAKE_SEED", 1);
+    session->d_tokens = 0;
+    return session;
+}
+
+void blpapi_Session_destroy(blpapi_Session_t *session)
+{
+    pthread_mutex_lock(&session->d_lock);
+    session->d_terminate = true;
+    while (!session->d_events.empty()) {
+        blpapi_Event_release(session->d_events.front());
+        session->d_events.pop_front();
+    }
+    pthread_cond_broadcast(&session->d_cond);
+    pthread_mutex_unlock(&session->d_lock);
+    if (session->d_threadStarted) {
+        pthread_join(session->d_thread, 0);
+    }
+    while (!session->d_events.empty()) {
+        blpapi_Event_release(session->d_events.front());
+        session->d_events.pop_front();
+    }
+
+    for (SubscriptionMap::iterator it = session->d_subscriptions.begin();
+         it != session->d_subscriptions.end();
+         ++it) {
+        delete it->second;
+    }
+    for (std::map<std::string, blpapi_Service *>::iterator it =
+                                                  session->d_services.begin();
+         it != session->d_services.end();
+         ++it) {
+        blpapi_Service_release(it->second);
+    }
+    pthread_cond_destroy(&session->d_cond);
+    pthread_mutex_destroy(&session->d_lock);
+    delete session;
+}
+
+blpapi_AbstractSession_t *blpapi_Session_getAbstractSession(
+                                                   blpapi_Session_t *session)
+{
+    return &session->d_abstract;
+}
+
+int blpapi_Session_startAsync(blpapi_Session_t *session)
+{
+    pthread_mutex_lock(&session->d_lock);
+    if (session->d_started || session->d_terminate) {
+        pthread_mutex_unlock(&session->d_lock);
+        return fail(BLPAPI_ERROR_ILLEGAL_STATE,
+                    "Session has already been started");
+    }
+    session->d_started = true;
+
+    blpapi_Event *event = new blpapi_Event(BLPAPI_EVENTTYPE_SESSION_STATUS);
+    // Connect to the first of the configured server addresses; the fake
+    // never fails over to the others.
+    std::ostringstream server;
+    server << session->d_options.d_serverAddresses[0].first << ':'
+           << session->d_options.d_serverAddresses[0].second;
+    blpapi_Message *m = event->add("SessionConnectionUp", 0);
+    m->d_root->add("server", BLPAPI_DATATYPE_STRING)->setString(server.str());
+    event->add("SessionStarted", 0);
+    session->post(event);
+
+    session->d_threadStarted =
+                     0 == pthread_create(&session->d_thread, 0, dispatch,
+                                         session);
+    pthread_mutex_unlock(&session->d_lock);
+    return session->d_threadStarted
+               ? 0 : fail(BLPAPI_ERROR_INTERNAL_ERROR,
+                          "Failed to start the dispatcher thread");
+}
+
+int blpapi_Session_start(blpapi_Session_t *session)
+{
+    return blpapi_Session_startAsync(session);
+}
+
+int blpapi_Session_stopAsync(blpapi_Session_t *session)
+{
+    pthread_mutex_lock(&session->d_lock);
+    if (session->d_started && !session->d_terminate) {
+        for (SubscriptionMap::iterator it = session->d_subscriptions.begin();
+             it != session->d_subscriptions.end();
+             ++it) {
+            delete it->second;
+        }
+        session->d_subscriptions.clear();
+        session->post(statusEvent(BLPAPI_EVENTTYPE_SESSION_STATUS,
+                                  "SessionTerminated"));
+        session->d_terminate = true;
+    }
+    pthread_mutex_unlock(&session->d_lock);
+    return 0;
+}
+
+int blpapi_Session_stop(blpapi_Session_t *session)
+{
+    blpapi_Session_stopAsync(session);
+    if (session->d_threadStarted &&
+        !pthread_equal(pthread_self(), session->d_thread)) {
+        pthread_join(session->d_thread, 0);
+        session->d_threadStarted = false;
+    }
+    return 0;
+}
+
+int blpapi_Session_nextEvent(blpapi_Session_t *,
+                             blpapi_Event_t  **,
+                             unsigned int)
+{
+    return fail(BLPAPI_ERROR_UNSUPPORTED_OPERATION,
+                "The fake session only dispatches to its event handler");
+}
+
+int blpapi_Session_tryNextEvent(blpapi_Session_t *, blpapi_Event_t **)
+{
+    return fail(BLPAPI_ERROR_UNSUPPORTED_OPERATION,
+                "The fake session only dispatches to its event handler");
+}
+
+int blpapi_AbstractSession_openServiceAsync(
+                                     blpapi_AbstractSession_t *abstract,
+                                     const char               *uri,
+                                     blpapi_CorrelationId_t   *correlationId)
+{
+    blpapi_Session *session = abstract->d_session;
+    autogenCorrelationId(correlationId);
+
+    const std::string name(uri);
+    blpapi_Event *event = new blpapi_Event(BLPAPI_EVENTTYPE_SERVICE_STATUS);
+    pthread_mutex_lock(&session->d_lock);
+    if ("//blp/mktdata" == name ||
+        "//blp/refdata" == name ||
+        "//blp/apiauth" == name) {
+        if (!session->d_services.count(name)) {
+            blpapi_Service *service = new blpapi_Service;
+            service->d_refs = 1;
+            service->d_name = name;
+            session->d_services[name] = service;
+        }
+        event->add("ServiceOpened", correlationId)
+             ->d_root->add("serviceName", BLPAPI_DATATYPE_STRING)
+             ->setString(name);
+    } else {
+        blpapi_Message *m = event->add("ServiceOpenFailure", correlationId);
+        m->d_root->add("serviceName", BLPAPI_DATATYPE_STRING)
+                 ->setString(name);
+        addReason(m->d_root, "NOT_FOUND", "Service not found");
+    }
+    session->post(event);
+    pthread_mutex_unlock(&session->d_lock);
+    return 0;
+}
+
+int blpapi_AbstractSession_getService(blpapi_AbstractSession_t  *abstract,
+                                      blpapi_Service_t         **service,
+                                      const char                *uri)
+{
+    blpapi_Session *session = abstract->d_session;
+    pthread_mutex_lock(&session->d_lock);
+    std::map<std::string, blpapi_Service *>::iterator it =
+                                                session->d_services.find(uri);
+    if (it != session->d_services.end()) {
+        // The handle is borrowed: the caller adds its own reference.
+        *service = it->second;
+    }
+    pthread_mutex_unlock(&session->d_lock);
+    return it != session->d_services.end()
+               ? 0 : fail(BLPAPI_ERROR_SERVICE_NOT_FOUND,
+                          std::string("Service not opened: ") + uri);
+}
+
+blpapi_Identity_t *blpapi_AbstractSession_createIdentity(
+                                          blpapi_AbstractSession_t *)
+{
+    blpapi_Identity_t *identity = new blpapi_Identity_t;
+    identity->d_refs = 1;
+    return identity;
+}
+
+int blpapi_AbstractSession_generateToken(
+                                     blpapi_AbstractSession_t *abstract,
+                                     blpapi_CorrelationId_t   *correlationId,
+                                     blpapi_EventQueue_t      *)
+{
+    blpapi_Session *session = abstract->d_session;
+    autogenCorrelationId(correlationId);
+
+    pthread_mutex_lock(&session->d_lock);
+    std::ostringstream token;
+    token << "fake-token-" << ++session->d_tokens;
+    blpapi_Event *event = new blpapi_Event(BLPAPI_EVENTTYPE_TOKEN_STATUS);
+    event->add("TokenGenerationSuccess", correlationId)
+         ->d_root->add("token", BLPAPI_DATATYPE_STRING)
+         ->setString(token.str());
+    session->post(event);
+    pthread_mutex_unlock(&session->d_lock);
+    return 0;
+}
+
+int blpapi_AbstractSession_sendAuthorizationRequest(
+                                     blpapi_AbstractSession_t *abstract,
+                                     const blpapi_Request_t   *request,
+                                     blpapi_Identity_t        *,
+                                     blpapi_CorrelationId_t   *correlationId,
+                                     blpapi_EventQueue_t      *,
+                                     const char               *,
+                                     int)
+{
+    if ("AuthorizationRequest" != request->d_operation) {
+        return invalidArg("Not an authorization request");
+    }
+    autogenCorrelationId(correlationId);
+    blpapi_Event *event = new blpapi_Event(BLPAPI_EVENTTYPE_RESPONSE);
+    event->add("AuthorizationSuccess", correlationId);
+    abstract->d_session->postLocked(event);
+    return 0;
+}
+
+int blpapi_Session_sendRequest(blpapi_Session_t        *session,
+                               const blpapi_Request_t  *request,
+                               blpapi_CorrelationId_t  *correlationId,
+                               blpapi_Identity_t       *,
+                               blpapi_EventQueue_t     *,
+                               const char              *,
+                               int)
+{
+    autogenCorrelationId(correlationId);
+
+    std::vector<blpapi_Message *> messages;
+    const std::string& op = request->d_operation;
+    if ("ReferenceDataRequest" == op) {
+        referenceData(&messages, *request, *correlationId);
+    } else if ("HistoricalDataRequest" == op) {
+        historicalData(&messages, *request, *correlationId);
+    } else if ("IntradayTickRequest" == op) {
+        intradayData(&messages, *request, *correlationId, false);
+    } else if ("IntradayBarRequest" == op) {
+        intradayData(&messages, *request, *correlationId, true);
+    } else {
+        return invalidArg("Unsupported request");
+    }
+    postResponse(session, messages);
+    return 0;
+}
+
+int blpapi_Session_subscribe(blpapi_Session_t                *session,
+                             const blpapi_SubscriptionList_t *list,
+                             const blpapi_Identity_t         *,
+                             const char                      *,
+                             int)
+{
+    pthread_mutex_lock(&session->d_lock);
+    for (std::size_t i = 0; i < list->d_entries.size(); ++i) {
+        CorrelationKey key(list->d_entries[i].d_cid);
+        if (session->d_subscriptions.count(key)) {
+            pthread_mutex_unlock(&session->d_lock);
+            return fail(BLPAPI_ERROR_DUPLICATE_CORRELATIONID,
+                        "Duplicate correlation id");
+        }
+    }
+
+    blpapi_Event *status =
+                    new blpapi_Event(BLPAPI_EVENTTYPE_SUBSCRIPTION_STATUS);
+    const blpapi_Int64_t now = nowNanoseconds();
+    for (std::size_t i = 0; i < list->d_entries.size(); ++i) {
+        const blpapi_SubscriptionList::Entry& entry = list->d_entries[i];
+        blpapi_CorrelationId_t cid;
+        copyCorrelationId(&cid, entry.d_cid);
+        autogenCorrelationId(&cid);
+
+        if (isInvalid(entry.d_topic)) {
+            blpapi_Message *m = status->add("SubscriptionFailure",
+                                            &cid,
+                                            entry.d_topic);
+            addReason(m->d_root, "BAD_SEC", "Unknown/Invalid security");
+            destroyCorrelationId(&cid);
+            continue;
+        }
+        status->add("SubscriptionStarted", &cid, entry.d_topic);
+
+        Subscription *s = new Subscription;
+        s->d_topic = entry.d_topic;
+        s->d_cid = cid;
+        s->d_fields = entry.d_fields;
+        if (s->d_fields.empty()) {
+            s->d_fields.push_back("LAST_PRICE");
+        }
+        s->d_price = basePrice(entry.d_topic);
+        s->d_random = Random(hashString(entry.d_topic) ^ session->d_seed);
+        long rate = session->d_tickRate;
+        long count = session->d_tickCount;
+        for (std::size_t j = 0; j < entry.d_options.size(); ++j) {
+            const std::string& option = entry.d_options[j];
+            if (0 == option.find("fakeTickRate=")) {
+                rate = std::strtol(option.c_str() + 13, 0, 10);
+            } else if (0 == option.find("fakeTickCount=")) {
+                count = std::strtol(option.c_str() + 14, 0, 10);
+            }
+        }
+        s->d_interval = rate > 0 ? 1000000000LL / rate : 0;
+        s->d_due = now + s->d_interval;
+        s->d_remaining = count > 0 ? count : -1;
+        session->d_subscriptions[CorrelationKey(cid)] = s;
+    }
+    session->post(status);
+    pthread_mutex_unlock(&session->d_lock);
+    return 0;
+}
+
+int blpapi_Session_resubscribe(blpapi_Session_t                *session,
+                               const blpapi_SubscriptionList_t *list,
+                               const char                      *,
+                               int)
+{
+    pthread_mutex_lock(&session->d_lock);
+    for (std::size_t i = 0; i < list->d_entries.size(); ++i) {
+        const blpapi_SubscriptionList::Entry& entry = list->d_entries[i];
+        SubscriptionMap::iterator it =
+              session->d_subscriptions.find(CorrelationKey(entry.d_cid));
+        if (it != session->d_subscriptions.end() && !entry.d_fields.empty()) {
+            it->second->d_fields = entry.d_fields;
+        }
+    }
+    pthread_mutex_unlock(&session->d_lock);
+    return 0;
+}
+
+int blpapi_Session_unsubscribe(blpapi_Session_t                *session,
+                               const blpapi_SubscriptionList_t *list,
+                               const char                      *,
+                               int)
+{
+    pthread_mutex_lock(&session->d_lock);
+    for (std::size_t i = 0; i < list->d_entries.size(); ++i) {
+        SubscriptionMap::iterator it = session->d_subscriptions.find(
+                                     CorrelationKey(list->d_entries[i].d_cid));
+        if (it != session->d_subscriptions.end()) {
+            delete it->second;
+            session->d_subscriptions.erase(it);
+        }
+    }
+    pthread_mutex_unlock(&session->d_lock);
+    return 0;
+}
+
+}  // extern "C"
+
+// Local variables:
+// c-basic-offset: 4
+// tab-width: 4
+// indent-tabs-mode: nil
+// End:
+//
+// vi: set shiftwidth=4 tabstop=4 expandtab:
+// :indentSize=4:tabSize=4:noTabs=true:
+
+// ----------------------------------------------------------------------------
+// Copyright (C) 2015 Bloomberg L.P.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+// ----------------------------- END-OF-FILE ----------------------------------
@@ -25,7 +25,16 @@ session.on('ServiceOpened', function(m) {
     // Check to ensure the opened service is the apiauth service
     if (m.correlations[0].value == service_apiauth) {
         try {
-            session.authorize('//blp/apiauth', request_apiauth);
+            session.authorize('//blp/apiauth', request_apiauth).then(
+                function(m) {
+                    console.log('Authorization successful.');
+                    session.stop();
+                },
+                function(e) {
+                    console.log('Authorization response failure:',
+                                e.message);
+                    session.stop();
+                });
         } catch(e) {
             console.log('Authorization request failure:', e);
             session.stop();
@@ -33,22 +42,6 @@ session.on('ServiceOpened', function(m) {
     }
 });
 
-session.on('AuthorizationSuccess', function(m) {
-    // Match correlation identifier used when authorizing
-    if (m.correlations[0].value == request_apiauth) {
-        console.log('Authorization successful.');
-        session.stop();
-    }
-});
-
-session.on('AuthorizationFailure', function(m) {
-    // Match correlation identifier used when authorizing
-    if (m.correlations[0].value == request_apiauth) {
-        console.log('Authorization response failure.');
-        session.stop();
-    }
-});
-
 session.on('SessionTerminated', function(m) {
     // Once the session is stopped, release the event loop
     session.destroy();
@@ -0,0 +1,175 @@
+// Stress test of several sessions dispatching at once, run against the fake
+// BLPAPI library (see "Building Against A Fake BLPAPI" in the README).
+//
+// Every session subscribes to a few securities whose streams stop after a
+// fixed number of ticks, then stops once it received all of them.  The
+// test fails if any session misses a message, receives one too many, or
+// does not terminate before the deadline, which is what happens when the
+// events of one session wait in its queue for a wakeup that never comes.
+//
+// On a build against the real library, which has no deterministic streams
+// to check, the test is skipped and exits with status 0.
+//
+// Usage: node test/stress.js [--sessions=N] [--subscriptions=N]
+//            [--ticks=N] [--rate=N] [--deadline=S]
+
+var path = require('path');
+var blpapi = require(path.join(__dirname, '..'));
+
+if (!require(path.join(__dirname, '../build/Release/blpapijs')).fake) {
+    console.log('SKIP the stress test needs a fake build, made with ' +
+                '"node-gyp rebuild -- -Dblpapi_fake=true"');
+    process.exit(0);
+}
+
+var options = {
+    sessions: 8,
+    subscriptions: 4,       // per session
+    ticks: 500,             // per subscription
+    rate: 1000,             // ticks per second per subscription, 0 unpaced
+    deadline: 30            // seconds
+};
+process.argv.slice(2).forEach(function(arg) {
+    var m = /^--([a-z]+)=(\d+)$/.exec(arg);
+    if (!m || !(m[1] in options)) {
+        console.error('Unknown argument:', arg);
+        process.exit(2);
+    }
+    options[m[1]] = Number(m[2]);
+});
+
+var expected = options.subscriptions * options.ticks;
+var sessions = [];
+var failures = [];
+var remaining = options.sessions;
+var finished = false;
+var start = Date.now();
+
+function fail(s, reason)
+{
+    failures.push('session ' + s.index + ': ' + reason);
+}
+
+function finish()
+{
+    if (finished) {
+        return;
+    }
+    finished = true;
+    clearTimeout(deadline);
+    sessions.forEach(function(s) {
+        if (!s.terminated) {
+            fail(s, 'received ' + s.received + ' of ' + expected +
+                    ' messages before the deadline');
+            s.session.destroy();
+        }
+    });
+    if (failures.length) {
+        failures.forEach(function(f) { console.error('FAIL', f); });
+        process.exit(1);
+    }
+    console.log('OK ' + options.sessions + ' sessions received ' +
+                options.sessions * expected + ' messages in ' +
+                (Date.now() - start) + ' ms');
+}
+
+var deadline = setTimeout(finish, options.deadline * 1000);
+
+function run(index)
+{
+    var session = new blpapi.Session({ serverHost: '127.0.0.1',
+                                       serverPort: 8194 });
+    var s = { index: index,
+              session: session,
+              received: 0,
+              perSubscription: {},
+              terminated: false };
+    sessions.push(s);
+
+    session.on('SessionStarted', function() {
+        session.openService('//blp/mktdata', 1);
+    });
+
+    session.on('SessionStartupFailure', function() {
+        fail(s, 'could not start; the test needs a fake build');
+        finish();
+    });
+
+    session.on('ServiceOpened', function() {
+        var subscriptions = [];
+        for (var i = 0; i < options.subscriptions; ++i) {
+            s.perSubscription[100 + i] = 0;
+            subscriptions.push({
+                security: 'STRESS' + index + '_' + i + ' US Equity',
+                correlation: 100 + i,
+                fields: ['LAST_PRICE'],
+                options: { fakeTickRate: options.rate,
+                           fakeTickCount: options.ticks }
+            });
+        }
+        session.subscribe(subscriptions);
+    });
+
+    session.on('MarketDataEvents', function(m) {
+        var cid = m.correlations[0].value;
+        if (++s.perSubscription[cid] > options.ticks) {
+            fail(s, 'subscription ' + cid + ' received more than ' +
+                    options.ticks + ' messages');
+        }
+        if (++s.received === expected) {
+            session.stop();
+        }
+    });
+
+    session.on('SessionTerminated', function() {
+        s.terminated = true;
+        session.destroy();
+        for (var cid in s.perSubscription) {
+            if (s.perSubscription[cid] !== options.ticks) {
+                fail(s, 'subscription ' + cid + ' received ' +
+                        s.perSubscription[cid] + ' of ' + options.ticks +
+                        ' messages');
+            }
+        }
+        if (0 === --remaining) {
+            finish();
+        }
+    });
+
+    session.start();
+}
+
+for (var i = 0; i < options.sessions; ++i) {
+    run(i);
+}
+
+// Local variables:
+// c-basic-offset: 4
+// tab-width: 4
+// indent-tabs-mode: nil
+// End:
+//
+// vi: set shiftwidth=4 tabstop=4 expandtab:
+// :indentSize=4:tabSize=4:noTabs=true:
+
+// ----------------------------------------------------------------------------
+// Copyright (C) 2015 Bloomberg L.P.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+// ----------------------------- END-OF-FILE ----------------------------------